@@ -0,0 +1,829 @@
+#include "header.h"
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <thread>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+// Count heap allocations so each benchmark can report allocs/call. The
+// whole new/delete set is replaced, out of line, so GCC never pairs an
+// inlined free() with a call to operator new.
+static size_t allocCount = 0;
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    allocCount++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+__attribute__((noinline)) void *operator new[](size_t size) { return operator new(size); }
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void *p) noexcept { operator delete(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { operator delete(p); }
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept { operator delete(p); }
+
+template <typename F>
+static void bench(const char *name, int iterations, F fn)
+{
+    size_t allocsBefore = allocCount;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    printf("  %-36s %10.0f ns/call %8.1f allocs/call\n", name,
+           elapsed / iterations, (double)(allocCount - allocsBefore) / iterations);
+}
+
+// ---------------------------------------------------------------------
+// Reference collectors: the ifstream + getline versions the ProcFile
+// readers replaced, kept here for the before/after comparison.
+// ---------------------------------------------------------------------
+
+static MemInfo streamMemInfo()
+{
+    MemInfo info = {0, 0, 0};
+    ifstream file("/proc/meminfo");
+    string line;
+    while (getline(file, line)) {
+        if (line.find("MemTotal:") != string::npos) {
+            sscanf(line.c_str(), "MemTotal: %lld kB", &info.total);
+            info.total *= 1024;
+        } else if (line.find("MemAvailable:") != string::npos) {
+            sscanf(line.c_str(), "MemAvailable: %lld kB", &info.available);
+            info.available *= 1024;
+        }
+    }
+    info.used = info.total - info.available;
+    return info;
+}
+
+static CPUStats streamCPUStats()
+{
+    CPUStats stats = {0};
+    ifstream file("/proc/stat");
+    string line;
+    if (getline(file, line) && line.find("cpu") == 0) {
+        sscanf(line.c_str(), "cpu %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+               &stats.user, &stats.nice, &stats.system, &stats.idle,
+               &stats.iowait, &stats.irq, &stats.softirq, &stats.steal,
+               &stats.guest, &stats.guestNice);
+    }
+    return stats;
+}
+
+static NetStats streamNetStats()
+{
+    NetStats stats;
+    ifstream file("/proc/net/dev");
+    string line;
+    getline(file, line);
+    getline(file, line);
+    while (getline(file, line)) {
+        size_t colon = line.find(':');
+        if (colon != string::npos) {
+            string iface = line.substr(0, colon);
+            iface.erase(0, iface.find_first_not_of(" \t"));
+            string data = line.substr(colon + 1);
+            RX rx = {0};
+            TX tx = {0};
+            sscanf(data.c_str(), "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+                   &rx.bytes, &rx.packets, &rx.errs, &rx.drop, &rx.fifo, &rx.frame, &rx.compressed, &rx.multicast,
+                   &tx.bytes, &tx.packets, &tx.errs, &tx.drop, &tx.fifo, &tx.colls, &tx.carrier, &tx.compressed);
+            stats.rx[iface] = rx;
+            stats.tx[iface] = tx;
+        }
+    }
+    return stats;
+}
+
+static void benchCollectors()
+{
+    const int iterations = 20000;
+    volatile long long sink = 0;
+
+    printf("Collectors (ifstream + getline vs ProcFile + pread):\n");
+    bench("getMemInfo / ifstream", iterations, [&] { sink += streamMemInfo().used; });
+    bench("getMemInfo / ProcFile", iterations, [&] { sink += getMemInfo().used; });
+    bench("getCPUStats / ifstream", iterations, [&] { sink += streamCPUStats().user; });
+    bench("getCPUStats / ProcFile", iterations, [&] { sink += getCPUStats().user; });
+    CoreStats cores;
+    bench("readCoreStats / every core", iterations, [&] { sink += readCoreStats(cores) ? cores.count : 0; });
+    bench("getNetStats / ifstream", iterations, [&] { sink += streamNetStats().rx.size(); });
+    bench("getNetStats / ProcFile", iterations, [&] { sink += getNetStats().rx.size(); });
+}
+
+// ---------------------------------------------------------------------
+// The cpu lines of /proc/stat on a 256-core machine: sscanf per line vs
+// the hand-written line parser
+// ---------------------------------------------------------------------
+
+static void benchCoreStatParser()
+{
+    const int cores = 256;
+    vector<string> lines;
+    lines.push_back("cpu  74608 2520 24433 1117073 6176 4054 0 0 0 0");
+    for (int core = 0; core < cores; core++) {
+        lines.push_back("cpu" + to_string(core) + " 9361 316 3069 139593 762 524 " + to_string(core * 7) +
+                        " 0 0 0");
+    }
+
+    printf("Parsing %d cpu lines:\n", cores + 1);
+    volatile long long sink = 0;
+    bench("sscanf", 2000, [&] {
+        for (const string &line : lines) {
+            CPUStats stats = {0};
+            int cpu = -1;
+            if (line.compare(0, 4, "cpu ") == 0) {
+                sscanf(line.c_str(), "cpu %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld", &stats.user,
+                       &stats.nice, &stats.system, &stats.idle, &stats.iowait, &stats.irq, &stats.softirq,
+                       &stats.steal, &stats.guest, &stats.guestNice);
+            } else {
+                sscanf(line.c_str(), "cpu%d %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld", &cpu, &stats.user,
+                       &stats.nice, &stats.system, &stats.idle, &stats.iowait, &stats.irq, &stats.softirq,
+                       &stats.steal, &stats.guest, &stats.guestNice);
+            }
+            sink += stats.softirq + cpu;
+        }
+    });
+    bench("parseCpuStatLine", 2000, [&] {
+        for (const string &line : lines) {
+            CPUStats stats;
+            int cpu;
+            if (parseCpuStatLine(line.c_str(), cpu, stats)) sink += stats.softirq + cpu;
+        }
+    });
+}
+
+// ---------------------------------------------------------------------
+// Per-core CPU time breakdown on 256 cores: one division per component
+// per core walking CPUStats structs vs computeCoreUsage's fixed-length
+// lane loops over the column-major counters readCoreStats fills.
+// ---------------------------------------------------------------------
+
+static void benchCpuBreakdown()
+{
+    static CPUStats prevCores[CoreStats::maxCores], currCores[CoreStats::maxCores];
+    static CoreStats prev, curr;
+    static CoreUsage usage;
+    prev.count = curr.count = CoreStats::maxCores;
+    for (int core = 0; core < CoreStats::maxCores; core++) {
+        prevCores[core] = {9361, 316, 3069, 139593, 762, 524, 100, 12, 0, 0};
+        currCores[core] = {9361 + core, 316, 3069 + core / 2, 139593 + 200 - core, 762 + core % 7, 524, 101,
+                           12 + core % 3, 0, 0};
+        prev.setCore(core, prevCores[core]);
+        curr.setCore(core, currCores[core]);
+    }
+    prev.total = prevCores[0];
+    curr.total = currCores[0];
+
+    printf("CPU breakdown of %d cores:\n", CoreStats::maxCores);
+    volatile float sink = 0;
+    bench("per-core struct divisions", 20000, [&] {
+        static float shares[CoreStats::maxCores][CPU_COMPONENTS];
+        for (int core = 0; core < curr.count; core++) {
+            const CPUStats &a = prevCores[core], &b = currCores[core];
+            long long delta[CPU_COMPONENTS] = {
+                b.user - a.user, b.nice - a.nice, b.system - a.system, b.irq - a.irq,
+                b.softirq - a.softirq, b.steal - a.steal, b.iowait - a.iowait, b.idle - a.idle,
+            };
+            long long sum = 0;
+            for (int c = 0; c < CPU_COMPONENTS; c++) sum += delta[c] > 0 ? delta[c] : 0;
+            for (int c = 0; c < CPU_COMPONENTS; c++) {
+                shares[core][c] = sum > 0 && delta[c] > 0 ? 100.0f * delta[c] / sum : 0.0f;
+            }
+        }
+        sink += shares[7][CPU_USER];
+    });
+    bench("computeCoreUsage", 20000, [&] {
+        computeCoreUsage(prev, curr, usage);
+        sink += usage.breakdown[CPU_USER][7];
+    });
+}
+
+// ---------------------------------------------------------------------
+// /proc/[pid]/stat parsing: sscanf into a char buffer vs the hand-written
+// parser. The old getProcesses() read comm with "%s", which stops at the
+// space in "Web Content" and leaves every later field unparsed; the
+// baseline reads it with "%[^)]" so both sides parse the same fields.
+// ---------------------------------------------------------------------
+
+static const char statLine[] =
+    "31337 (Web Content) R 2000 1999 1999 0 -1 4194304 900000 0 12 0 123456 7890 0 0 20 0 41 0 "
+    "555 4000000000 250000 18446744073709551615 1 1 0 0 0 0 0 4096 1260 0 0 0 17 2 0 0 5 0 0 0 0 0 0 0 0 0 0\n";
+
+static void sscanfProcStat(const char *line, Proc &proc)
+{
+    // The same fields parseProcStat keeps, up to field 42
+    char name[256];
+    proc.blkioTicks = 0;
+    sscanf(line,
+           "%d (%255[^)]) %c %d %*d %*d %*d %*d %*u %lld %*u %lld %*u %lld %lld %*d %*d %*d %*d %*d %*d %llu %lld %lld "
+           "%*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*d %*d %*u %*u %lld",
+           &proc.pid, name, &proc.state, &proc.ppid, &proc.minflt, &proc.majflt, &proc.utime, &proc.stime,
+           &proc.starttime, &proc.vsize, &proc.rss, &proc.blkioTicks);
+    proc.name = string(name);
+}
+
+static void benchStatParser()
+{
+    const int iterations = 1000000;
+    Proc proc = {0};
+    volatile long long sink = 0;
+
+    printf("/proc/[pid]/stat parsing:\n");
+    auto start = chrono::steady_clock::now();
+    bench("sscanf", iterations, [&] { sscanfProcStat(statLine, proc); sink += proc.rss + proc.blkioTicks; });
+    double sscanfSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    bench("parseProcStat", iterations, [&] {
+        parseProcStat(statLine, sizeof(statLine) - 1, proc);
+        sink += proc.rss + proc.blkioTicks;
+    });
+    double parserSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    Proc scanned = {0};
+    sscanfProcStat(statLine, scanned);
+    bool same = scanned.ppid == proc.ppid && scanned.minflt == proc.minflt && scanned.majflt == proc.majflt &&
+                scanned.starttime == proc.starttime && scanned.rss == proc.rss && scanned.blkioTicks == proc.blkioTicks;
+    printf("  %.1fM parses/s (sscanf) vs %.1fM parses/s (parseProcStat), fields %s\n",
+           iterations / sscanfSecs / 1e6, iterations / parserSecs / 1e6, same ? "match" : "DIFFER");
+    // The scan skips field 42 while delay accounting is off (the default)
+    bench("parseProcStat without field 42", iterations, [&] {
+        parseProcStat(statLine, sizeof(statLine) - 1, proc, false);
+        sink += proc.rss;
+    });
+}
+
+// ---------------------------------------------------------------------
+// Synthetic /proc tree: <dir>/<pid>/stat for `count` fake processes
+// ---------------------------------------------------------------------
+
+static string makeSyntheticProc(int count)
+{
+    char dir[] = "/tmp/monitor-bench-proc-XXXXXX";
+    if (!mkdtemp(dir)) return "";
+
+    char path[PATH_MAX];
+    for (int pid = 1; pid <= count; pid++) {
+        snprintf(path, sizeof(path), "%s/%d", dir, pid);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s/%d/stat", dir, pid);
+        FILE *f = fopen(path, "w");
+        if (!f) continue;
+        fprintf(f, "%d (worker %d) S 1 %d %d 0 -1 4194304 900 0 12 0 %d %d 0 0 20 0 1 0 %d 40000000 %d 0\n",
+                pid, pid % 97, pid, pid, pid * 3, pid, 1000 + pid, pid * 10);
+        fclose(f);
+    }
+    return dir;
+}
+
+static void removeSyntheticProc(const string &dir, int count)
+{
+    char path[PATH_MAX];
+    for (int pid = 1; pid <= count; pid++) {
+        snprintf(path, sizeof(path), "%s/%d/stat", dir.c_str(), pid);
+        unlink(path);
+        snprintf(path, sizeof(path), "%s/%d", dir.c_str(), pid);
+        rmdir(path);
+    }
+    rmdir(dir.c_str());
+}
+
+static void benchParallelScan()
+{
+    const int count = 20000;
+    string root = makeSyntheticProc(count);
+    if (root.empty()) {
+        printf("Parallel scan: cannot create synthetic /proc\n");
+        return;
+    }
+
+    printf("Parallel scan of %d synthetic pids (%u hardware threads):\n", count, thread::hardware_concurrency());
+    vector<int> pids;
+    vector<Proc> procs;
+    listPids(root.c_str(), pids);
+    scanProcStats(root.c_str(), pids, 1, procs);  // warm the dentry cache
+    int maxThreads = max(8, defaultScanThreads());
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        char name[64];
+        snprintf(name, sizeof(name), "scanProcStats / %d thread%s", threads, threads > 1 ? "s" : "");
+        bench(name, 10, [&] { scanProcStats(root.c_str(), pids, threads, procs); });
+    }
+    removeSyntheticProc(root, count);
+}
+
+// ---------------------------------------------------------------------
+// Enumerating and opening 100k synthetic pids: opendir/readdir and
+// absolute path strings vs getdents64 and openat on a directory fd
+// ---------------------------------------------------------------------
+
+static void benchPidEnumeration()
+{
+    const int count = 100000;
+    string root = makeSyntheticProc(count);
+    if (root.empty()) {
+        printf("Pid enumeration: cannot create synthetic /proc\n");
+        return;
+    }
+
+    printf("Enumerating %d synthetic pids:\n", count);
+    vector<int> pids;
+    bench("opendir/readdir + isdigit", 10, [&] {
+        pids.clear();
+        DIR *dir = opendir(root.c_str());
+        while (struct dirent *entry = readdir(dir)) {
+            if (isdigit(entry->d_name[0])) pids.push_back(atoi(entry->d_name));
+        }
+        closedir(dir);
+    });
+    bench("getdents64 listPids", 10, [&] { listPids(root.c_str(), pids); });
+
+    volatile int sink = 0;
+    bench("open by string path", 5, [&] {
+        for (int pid : pids) {
+            string path = root + "/" + to_string(pid) + "/stat";
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            sink = fd;
+            close(fd);
+        }
+    });
+    int dirfd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    bench("openat on the root fd", 5, [&] {
+        for (int pid : pids) {
+            int fd = openPidFile(dirfd, pid, "stat");
+            sink = fd;
+            close(fd);
+        }
+    });
+    close(dirfd);
+    (void)sink;
+    removeSyntheticProc(root, count);
+}
+
+// ---------------------------------------------------------------------
+// Sorting 100k processes: vector<Proc> (records with embedded strings)
+// vs an index permutation over the ProcTable columns
+// ---------------------------------------------------------------------
+
+static void fillSyntheticTable(int count, vector<Proc> &procs, ProcTable &table, NameTable &names)
+{
+    srand(42);
+    procs.resize(count);
+    for (int i = 0; i < count; i++) {
+        Proc &proc = procs[i];
+        proc.pid = i + 1;
+        proc.name = "worker-process-" + to_string(i % 500);
+        proc.state = "RSDZ"[rand() % 4];
+        proc.utime = rand();
+        proc.stime = rand();
+        proc.starttime = rand();
+        proc.vsize = (long long)rand() * 4096;
+        proc.rss = rand() % 1000000;
+        proc.cpu_percent = (rand() % 10000) / 100.0f;
+        table.insert(proc, names.intern(proc.name));
+    }
+}
+
+static void benchColumnarSort()
+{
+    const int count = 100000;
+    vector<Proc> source;
+    ProcTable table;
+    NameTable names;
+    fillSyntheticTable(count, source, table, names);
+
+    printf("Sorting %d rows:\n", count);
+    vector<Proc> procs;
+    vector<uint32_t> order(count);
+    bench("by CPU / vector<Proc>", 10, [&] {
+        procs = source;
+        sort(procs.begin(), procs.end(), [](const Proc &a, const Proc &b) { return a.cpu_percent > b.cpu_percent; });
+    });
+    bench("by CPU / ProcTable column", 10, [&] {
+        for (int i = 0; i < count; i++) order[i] = i;
+        const float *cpu = table.cpuPercent.data();
+        sort(order.begin(), order.end(), [cpu](uint32_t a, uint32_t b) { return cpu[a] > cpu[b]; });
+    });
+    bench("by RSS / vector<Proc>", 10, [&] {
+        procs = source;
+        sort(procs.begin(), procs.end(), [](const Proc &a, const Proc &b) { return a.rss > b.rss; });
+    });
+    bench("by RSS / ProcTable column", 10, [&] {
+        for (int i = 0; i < count; i++) order[i] = i;
+        const long long *rss = table.rss.data();
+        sort(order.begin(), order.end(), [rss](uint32_t a, uint32_t b) { return rss[a] > rss[b]; });
+    });
+}
+
+// ---------------------------------------------------------------------
+// Re-sorting 50k rows after a refresh that changed 1% of them:
+// merge-based repair of the previous order vs a full sort
+// ---------------------------------------------------------------------
+
+static void benchIncrementalSort()
+{
+    const int count = 50000;
+    ProcSnapshot snap = ProcSnapshot();
+    vector<Proc> procs;
+    fillSyntheticTable(count, procs, snap.table, snap.names);
+    snap.generation = 1;
+
+    const vector<ProcSortKey> keys = {{PROC_SORT_CPU, true}};
+    ProcOrder incremental;
+    updateProcOrder(incremental, snap, keys);
+
+    // One refresh's worth of churn: 1% of rows change CPU%
+    auto churn = [&] {
+        snap.generation++;
+        snap.changes.updated.clear();
+        for (int i = 0; i < count / 100; i++) {
+            uint32_t row = rand() % count;
+            snap.table.cpuPercent[row] = (rand() % 10000) / 100.0f;
+            snap.changes.updated.push_back({snap.table.key(row), row});
+        }
+    };
+
+    printf("Re-sorting %d rows by CPU after 1%% churn:\n", count);
+    bench("full sort", 50, [&] {
+        churn();
+        ProcOrder full;
+        updateProcOrder(full, snap, keys);
+    });
+    updateProcOrder(incremental, snap, {{PROC_SORT_CPU, false}});
+    updateProcOrder(incremental, snap, keys);
+    bench("incremental repair", 50, [&] {
+        churn();
+        updateProcOrder(incremental, snap, keys);
+    });
+}
+
+// ---------------------------------------------------------------------
+// Filtering 100k processes with distinct names: per-frame copy+tolower
+// of every name vs the trigram index and the cached filter
+// ---------------------------------------------------------------------
+
+static void benchNameFilter()
+{
+    const int count = 100000;
+    ProcSnapshot snap = ProcSnapshot();
+    srand(3);
+    for (int i = 0; i < count; i++) {
+        Proc proc = {0};
+        proc.pid = i + 1;
+        proc.name = (i % 3 ? "Worker-" : "kthread/") + to_string(rand());
+        snap.table.insert(proc, snap.names.intern(proc.name));
+    }
+    snap.generation = 1;
+    ProcOrder order;
+    updateProcOrder(order, snap, {{PROC_SORT_PID, false}});
+
+    const char *query = "ker-1234";
+    printf("Filtering %d rows for \"%s\":\n", count, query);
+    size_t matched = 0;
+    bench("copy + tolower per row", 20, [&] {
+        string filterStr = query;
+        transform(filterStr.begin(), filterStr.end(), filterStr.begin(), ::tolower);
+        matched = 0;
+        for (uint32_t row : order.rows) {
+            string procName = snap.names.get(snap.table.nameId[row]);
+            transform(procName.begin(), procName.end(), procName.begin(), ::tolower);
+            matched += procName.find(filterStr) != string::npos;
+        }
+    });
+    bench("trigram index, new query", 20, [&] {
+        ProcFilter filter;
+        matched = updateProcFilter(filter, snap, order, query).size();
+    });
+    ProcFilter cached;
+    updateProcFilter(cached, snap, order, query);
+    bench("cached filter, unchanged", 20, [&] {
+        matched = updateProcFilter(cached, snap, order, query).size();
+    });
+    printf("  %zu matches\n", matched);
+}
+
+// ---------------------------------------------------------------------
+// Process table frame time with 100k rows, ImGui driven headless (no
+// renderer): every row submitted vs only the rows in view
+// ---------------------------------------------------------------------
+
+// The table body as it was before the clipper
+static void drawAllProcessRows(const ProcSnapshot &snap, const vector<uint32_t> &rows, long long ramTotal,
+                               vector<int> &selectedRows)
+{
+    const ProcTable &table = snap.table;
+    for (uint32_t i : rows) {
+        const string &name = snap.names.get(table.nameId[i]);
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        bool isSelected = find(selectedRows.begin(), selectedRows.end(), i) != selectedRows.end();
+        ImGui::Selectable(("##row" + to_string(i)).c_str(), isSelected, ImGuiSelectableFlags_SpanAllColumns);
+        ImGui::SameLine();
+        ImGui::Text("%d", table.pid[i]);
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Text("%s", name.c_str());
+        ImGui::TableSetColumnIndex(2);
+        ImGui::Text("%c", table.state[i]);
+        ImGui::TableSetColumnIndex(3);
+        ImGui::Text("%.1f", table.cpuPercent[i]);
+        ImGui::TableSetColumnIndex(4);
+        float memPercent = ramTotal > 0 ? (float)(table.rss[i] * 4096) / ramTotal * 100.0f : 0.0f;
+        ImGui::Text("%.1f", memPercent);
+    }
+}
+
+static void benchProcessTableFrame()
+{
+    const int count = 100000;
+    ProcSnapshot snap = ProcSnapshot();
+    vector<Proc> source;
+    fillSyntheticTable(count, source, snap.table, snap.names);
+    snap.generation = 1;
+    ProcOrder order;
+    updateProcOrder(order, snap, {{PROC_SORT_CPU, true}});
+    const long long ramTotal = 16LL << 30;
+    vector<int> selectedRows;
+    ProcSelection selection;
+    ProcThreads threads;
+    ProcIoRates ioRates;
+
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(1280, 720);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = NULL;
+    unsigned char *pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    auto frame = [&](bool clipped) {
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(0, 0));
+        ImGui::SetNextWindowSize(ImVec2(640, 400));
+        ImGui::Begin("Processes");
+        ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable;
+        if (clipped) {
+            flags |= ImGuiTableFlags_ScrollY;
+        }
+        // The clipped path draws the process window's full column set
+        if (ImGui::BeginTable("ProcessTable", clipped ? 14 : 5, flags)) {
+            if (clipped) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+            }
+            ImGui::TableSetupColumn("PID");
+            ImGui::TableSetupColumn("Name");
+            if (clipped) {
+                ImGui::TableSetupColumn("User");
+            }
+            ImGui::TableSetupColumn("State");
+            ImGui::TableSetupColumn("CPU %");
+            ImGui::TableSetupColumn("Memory %");
+            if (clipped) {
+                for (const char *name : {"Read/s", "Write/s", "Syscr/s", "Syscw/s", "MinFlt/s", "MajFlt/s",
+                                         "VolCsw/s", "InvolCsw/s"}) {
+                    ImGui::TableSetupColumn(name);
+                }
+            }
+            ImGui::TableHeadersRow();
+            if (clipped) {
+                drawProcessRows(snap, order.rows, ramTotal, selection, threads, ioRates);
+            } else {
+                drawAllProcessRows(snap, order.rows, ramTotal, selectedRows);
+            }
+            ImGui::EndTable();
+        }
+        ImGui::End();
+        ImGui::Render();
+    };
+
+    printf("Process table frame, %d rows:\n", count);
+    frame(false);
+    bench("every row submitted", 10, [&] { frame(false); });
+    frame(true);
+    bench("ImGuiListClipper", 100, [&] { frame(true); });
+    ImDrawData *draw = ImGui::GetDrawData();
+    printf("  %d vertices in the clipped frame\n", draw ? draw->TotalVtxCount : 0);
+
+    ImGui::DestroyContext();
+}
+
+// ---------------------------------------------------------------------
+// Selection membership for every row, 1000 of 100k rows selected:
+// linear find over row indices vs the (pid, starttime) hash set
+// ---------------------------------------------------------------------
+
+static void benchSelection()
+{
+    const int count = 100000;
+    ProcSnapshot snap = ProcSnapshot();
+    vector<Proc> source;
+    fillSyntheticTable(count, source, snap.table, snap.names);
+    for (uint32_t row = 0; row < snap.table.size(); row++) {
+        snap.index[snap.table.key(row)] = row;
+    }
+
+    vector<int> selectedRows;
+    ProcSelection selection;
+    for (int row = 0; row < count; row += count / 1000) {
+        selectedRows.push_back(row);
+        selectProc(selection, snap, row, true);
+    }
+
+    printf("Selection checks over %d rows, %zu selected:\n", count, selectedRows.size());
+    volatile size_t hits = 0;
+    bench("vector<int> + find", 5, [&] {
+        hits = 0;
+        for (int row = 0; row < count; row++) {
+            hits += find(selectedRows.begin(), selectedRows.end(), row) != selectedRows.end();
+        }
+    });
+    bench("ProcKey hash set", 5, [&] {
+        hits = 0;
+        for (uint32_t row = 0; row < (uint32_t)count; row++) {
+            hits += selection.contains(snap.table.key(row));
+        }
+    });
+    snap.generation = 1;
+    unsigned long generation = 1;
+    bench("totals + history per refresh", 100, [&] {
+        snap.generation = ++generation;
+        snap.passes++;
+        updateProcSelection(selection, snap);
+    });
+    printf("  %zu hits, %.1f%% CPU selected\n", (size_t)hits, selection.cpuPercent);
+}
+
+// ---------------------------------------------------------------------
+// Process tree over 50k tasks with ~1% of them changing per refresh:
+// incremental update vs a rebuild from the table
+// ---------------------------------------------------------------------
+
+static void benchProcTree()
+{
+    const int count = 50000;
+    ProcSnapshot snap = ProcSnapshot();
+    srand(11);
+    for (int i = 0; i < count; i++) {
+        Proc proc = {0};
+        proc.pid = i + 1;
+        proc.ppid = rand() % proc.pid;
+        proc.cpu_percent = rand() % 100 / 10.0f;
+        proc.rss = rand() % 100000;
+        proc.name = "task" + to_string(i % 700);
+        uint32_t row = snap.table.insert(proc, snap.names.intern(proc.name));
+        snap.index[snap.table.key(row)] = row;
+    }
+    snap.generation = 1;
+    ProcTree tree;
+    updateProcTree(tree, snap);
+
+    auto churn = [&] {
+        snap.generation++;
+        snap.changes = ProcChanges();
+        for (int i = 0; i < count / 100; i++) {
+            uint32_t row = rand() % snap.table.size();
+            snap.table.cpuPercent[row] = rand() % 100 / 10.0f;
+            snap.table.rss[row] = rand() % 100000;
+            if (rand() % 20 == 0) snap.table.ppid[row] = rand() % snap.table.pid[row];
+            snap.changes.updated.push_back({snap.table.key(row), row});
+        }
+    };
+
+    printf("Process tree, %d tasks, %d updates per refresh:\n", count, count / 100);
+    bench("rebuild from table", 20, [&] {
+        churn();
+        ProcTree fresh;
+        updateProcTree(fresh, snap);
+    });
+    updateProcTree(tree, snap);
+    bench("incremental update", 200, [&] {
+        churn();
+        updateProcTree(tree, snap);
+    });
+    printf("  root subtree: %.1f%% CPU\n", tree.subtreeCpu[0]);
+
+    // Wide fan-out: every task a direct child of pid 1, as under systemd or
+    // a container shim. Exits and reparenting come off one huge child list.
+    ProcSnapshot wide = ProcSnapshot();
+    for (int i = 0; i < count; i++) {
+        Proc proc = {0};
+        proc.pid = i + 1;
+        proc.ppid = i == 0 ? 0 : 1;
+        proc.cpu_percent = rand() % 100 / 10.0f;
+        proc.rss = rand() % 100000;
+        proc.name = "unit" + to_string(i % 700);
+        uint32_t row = wide.table.insert(proc, wide.names.intern(proc.name));
+        wide.index[wide.table.key(row)] = row;
+    }
+    wide.generation = 1;
+    ProcTree fan;
+    updateProcTree(fan, wide);
+    int nextPid = count + 1;
+    printf("Process tree, %d children under pid 1, %d exits + %d forks per refresh:\n", count - 1, count / 100,
+           count / 100);
+    bench("incremental update", 200, [&] {
+        wide.generation++;
+        wide.changes = ProcChanges();
+        for (int i = 0; i < count / 100; i++) {
+            uint32_t row = 1 + rand() % (wide.table.size() - 1);
+            if (!wide.table.alive[row]) continue;
+            ProcKey key = wide.table.key(row);
+            wide.changes.removed.push_back({key, row});
+            wide.index.erase(key);
+            wide.table.erase(row);
+        }
+        for (int i = 0; i < count / 100; i++) {
+            Proc proc = {0};
+            proc.pid = nextPid++;
+            proc.ppid = 1;
+            proc.name = "unit";
+            uint32_t row = wide.table.insert(proc, wide.names.intern(proc.name));
+            wide.index[wide.table.key(row)] = row;
+            wide.changes.added.push_back({wide.table.key(row), row});
+        }
+        updateProcTree(fan, wide);
+    });
+
+    // pid 1 open: its children are sorted once per complete pass, and only
+    // patched by the refreshes of a budgeted pass in between
+    ProcTreeView view;
+    view.open.insert(wide.table.key(0));
+    layoutProcTree(view, wide, fan);
+    bench("tree layout, same generation", 1000, [&] { layoutProcTree(view, wide, fan); });
+    bench("tree layout, refresh within a pass", 20, [&] {
+        wide.generation++;
+        fan.generation = wide.generation;
+        layoutProcTree(view, wide, fan);
+    });
+    bench("tree layout, new pass", 20, [&] {
+        wide.generation++;
+        wide.passes++;
+        fan.generation = wide.generation;
+        layoutProcTree(view, wide, fan);
+    });
+    printf("  %zu lines, %zu children of pid 1\n", view.lines.size(), fan.children[0].size());
+}
+
+static void benchTopN()
+{
+    const int count = 100000;
+    vector<Proc> source;
+    ProcSnapshot snap = ProcSnapshot();
+    fillSyntheticTable(count, source, snap.table, snap.names);
+    for (int i = 0; i < count; i++) {
+        snap.table.ioWait[i] = rand() % 8 == 0 ? (rand() % 1000) / 100.0f : 0.0f;
+    }
+
+    printf("Top 10 of %d rows, CPU + RSS + I/O wait:\n", count);
+    const ProcTable &table = snap.table;
+    vector<uint32_t> order(count);
+    volatile uint32_t sink = 0;
+    bench("full std::sort per metric", 10, [&] {
+        for (int metric = 0; metric < PROC_TOP_METRICS; metric++) {
+            for (int i = 0; i < count; i++) order[i] = i;
+            sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                if (metric == PROC_TOP_CPU) return table.cpuPercent[a] > table.cpuPercent[b];
+                if (metric == PROC_TOP_RSS) return table.rss[a] > table.rss[b];
+                return table.ioWait[a] > table.ioWait[b];
+            });
+            sink = order[0];
+        }
+    });
+    ProcTopN top;
+    bench("bounded heaps, one pass", 100, [&] {
+        snap.generation++;
+        updateProcTopN(top, snap);
+        sink = top.rows[PROC_TOP_CPU][0];
+    });
+    (void)sink;
+    printf("  heaviest: %.2f%% CPU, %lld pages\n", table.cpuPercent[top.rows[PROC_TOP_CPU][0]],
+           table.rss[top.rows[PROC_TOP_RSS][0]]);
+}
+
+int main()
+{
+    std::cout << "=== System Monitor Benchmarks ===" << std::endl;
+
+    benchCollectors();
+    benchStatParser();
+    benchCoreStatParser();
+    benchCpuBreakdown();
+    benchParallelScan();
+    benchPidEnumeration();
+    benchColumnarSort();
+    benchIncrementalSort();
+    benchNameFilter();
+    benchProcessTableFrame();
+    benchSelection();
+    benchProcTree();
+    benchTopN();
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+#include "header.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+
+static CgroupSnapshot cgroups;
+static bool cgroupsProbed = false;
+// Walk the directories again at least this often (in stat reads), to pick
+// up groups that have no new processes in them
+static const unsigned long cgroupRewalkEvery = 30;
+static bool rewalkPending = false;
+static vector<uint32_t> freeGroups;
+// Paths seen in /proc/[pid]/cgroup that the last walk did not find; they
+// do not trigger another walk until the periodic one
+static unordered_set<string> unknownPaths;
+
+// Read a small file from an open fd (closed here) into buf, NUL-terminated.
+// Returns the length or -1.
+static ssize_t readFd(int fd, char *buf, size_t cap)
+{
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, cap - 1);
+    close(fd);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+static ssize_t readFile(const string &path, char *buf, size_t cap)
+{
+    return readFd(open(path.c_str(), O_RDONLY | O_CLOEXEC), buf, cap);
+}
+
+// Value of the "key value" line starting with `key` in a flat-keyed file
+// (cpu.stat, memory.stat), or 0 if there is none
+static long long keyedValue(const char *buf, const char *key)
+{
+    size_t keyLen = strlen(key);
+    for (const char *line = buf; *line; ) {
+        if (strncmp(line, key, keyLen) == 0 && line[keyLen] == ' ') {
+            return strtoll(line + keyLen + 1, nullptr, 10);
+        }
+        const char *eol = strchr(line, '\n');
+        if (!eol) break;
+        line = eol + 1;
+    }
+    return 0;
+}
+
+// Sum of every "key=value" in a nested-keyed file (io.stat has one line
+// per device)
+static long long summedValue(const char *buf, const char *key)
+{
+    size_t keyLen = strlen(key);
+    long long sum = 0;
+    for (const char *p = strstr(buf, key); p; p = strstr(p + keyLen, key)) {
+        if (p == buf || p[-1] == ' ') sum += strtoll(p + keyLen, nullptr, 10);
+    }
+    return sum;
+}
+
+bool parseCgroupPath(const char *buf, size_t len, string &path)
+{
+    const char *p = buf;
+    const char *end = buf + len;
+    while (p < end) {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        if (eol - p >= 3 && memcmp(p, "0::", 3) == 0) {
+            path.assign(p + 3, eol - p - 3);
+            return !path.empty();
+        }
+        p = eol + 1;
+    }
+    return false;
+}
+
+static string findCgroupRoot()
+{
+    if (access("/sys/fs/cgroup/cgroup.controllers", F_OK) == 0) return "/sys/fs/cgroup";
+    if (access("/sys/fs/cgroup/unified/cgroup.controllers", F_OK) == 0) return "/sys/fs/cgroup/unified";
+    return "";
+}
+
+static uint32_t groupFor(const string &path, int depth)
+{
+    auto it = cgroups.index.find(path);
+    if (it != cgroups.index.end()) return it->second;
+
+    uint32_t id;
+    if (!freeGroups.empty()) {
+        id = freeGroups.back();
+        freeGroups.pop_back();
+    } else {
+        id = cgroups.groups.size();
+        cgroups.groups.emplace_back();
+    }
+    CgroupStats &group = cgroups.groups[id];
+    group = CgroupStats();
+    group.path = path;
+    group.depth = depth;
+    group.alive = true;
+    cgroups.index.emplace(path, id);
+    return id;
+}
+
+static void walk(const string &path, int depth, vector<uint8_t> &seen)
+{
+    uint32_t id = groupFor(path, depth);
+    if (seen.size() < cgroups.groups.size()) seen.resize(cgroups.groups.size());
+    seen[id] = 1;
+    cgroups.order.push_back(id);
+
+    DIR *dir = opendir((cgroups.root + path).c_str());
+    if (!dir) return;
+    vector<string> children;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_type == DT_DIR && entry->d_name[0] != '.') children.push_back(entry->d_name);
+    }
+    closedir(dir);
+    sort(children.begin(), children.end());
+    for (const string &child : children) {
+        walk(path == "/" ? "/" + child : path + "/" + child, depth + 1, seen);
+    }
+}
+
+// Walk the hierarchy, forget groups that are gone, and rebuild process
+// membership from each group's cgroup.procs (one read per group rather
+// than one per process).
+static void rewalk(const ProcSnapshot &snap)
+{
+    vector<uint8_t> seen;
+    cgroups.order.clear();
+    walk("/", 0, seen);
+    seen.resize(cgroups.groups.size());
+    for (uint32_t id = 0; id < cgroups.groups.size(); id++) {
+        CgroupStats &group = cgroups.groups[id];
+        if (!group.alive || seen[id]) continue;
+        cgroups.index.erase(group.path);
+        group.alive = false;
+        freeGroups.push_back(id);
+    }
+
+    unordered_map<int, ProcKey> keyOfPid;
+    const ProcTable &table = snap.table;
+    for (uint32_t row = 0; row < table.size(); row++) {
+        if (table.alive[row]) keyOfPid.emplace(table.pid[row], table.key(row));
+    }
+    cgroups.procGroup.clear();
+    static vector<char> buf(1 << 16);
+    for (uint32_t id : cgroups.order) {
+        CgroupStats &group = cgroups.groups[id];
+        group.processes = 0;
+        // cgroup.procs can be long; grow until it fits
+        ssize_t n;
+        while ((n = readFile(cgroups.root + group.path + "/cgroup.procs", buf.data(), buf.size())) >= 0 &&
+               (size_t)n == buf.size() - 1) {
+            buf.resize(buf.size() * 2);
+        }
+        if (n <= 0) continue;
+        for (char *p = buf.data(); *p;) {
+            char *next;
+            long pid = strtol(p, &next, 10);
+            if (next == p) break;
+            auto it = keyOfPid.find((int)pid);
+            if (it != keyOfPid.end() && cgroups.procGroup.emplace(it->second, id).second) group.processes++;
+            p = next;
+        }
+    }
+    for (auto it = unknownPaths.begin(); it != unknownPaths.end();) {
+        it = cgroups.index.count(*it) ? unknownPaths.erase(it) : next(it);
+    }
+}
+
+static void readStats(CgroupStats &group, double elapsed, double cpuScale)
+{
+    char buf[8192];
+    string dir = cgroups.root + group.path + "/";
+
+    if (readFile(dir + "cpu.stat", buf, sizeof(buf)) < 0) {
+        // Removed since the last walk
+        rewalkPending = true;
+        return;
+    }
+    long long usage = keyedValue(buf, "usage_usec");
+    long long throttled = keyedValue(buf, "throttled_usec");
+
+    long long current = 0, anon = 0, file = 0;
+    if (readFile(dir + "memory.current", buf, sizeof(buf)) > 0) current = strtoll(buf, nullptr, 10);
+    if (readFile(dir + "memory.stat", buf, sizeof(buf)) > 0) {
+        anon = keyedValue(buf, "anon");
+        file = keyedValue(buf, "file");
+    }
+    long long rbytes = 0, wbytes = 0, rios = 0, wios = 0;
+    if (readFile(dir + "io.stat", buf, sizeof(buf)) > 0) {
+        rbytes = summedValue(buf, "rbytes=");
+        wbytes = summedValue(buf, "wbytes=");
+        rios = summedValue(buf, "rios=");
+        wios = summedValue(buf, "wios=");
+    }
+    float pressure = 0;
+    if (readFile(dir + "cpu.pressure", buf, sizeof(buf)) > 0) {
+        const char *some = strstr(buf, "some avg10=");
+        if (some) pressure = strtof(some + 11, nullptr);
+    }
+
+    if (group.sampled && elapsed > 0) {
+        group.cpuPercent = max(0.0, (usage - group.usageUsec) * cpuScale);
+        group.readRate = max(0.0, (rbytes - group.readBytes) / elapsed);
+        group.writeRate = max(0.0, (wbytes - group.writeBytes) / elapsed);
+    }
+    group.usageUsec = usage;
+    group.throttledUsec = throttled;
+    group.memoryCurrent = current;
+    group.anon = anon;
+    group.file = file;
+    group.readBytes = rbytes;
+    group.writeBytes = wbytes;
+    group.rios = rios;
+    group.wios = wios;
+    group.pressureSome10 = pressure;
+    group.sampled = true;
+}
+
+void refreshCgroups(const ProcSnapshot &snap, const char *root)
+{
+    if (!cgroupsProbed || (root && cgroups.root != root)) {
+        cgroups = CgroupSnapshot();
+        freeGroups.clear();
+        unknownPaths.clear();
+        cgroups.root = root ? root : findCgroupRoot();
+        cgroupsProbed = true;
+    }
+    if (cgroups.root.empty()) return;
+
+    // The periodic re-walk goes with a stat read, at the start of a pass
+    bool newPass = cgroups.refreshes == 0 || snap.passes != cgroups.passes;
+    bool rebuild = cgroups.generation == 0 || snap.generation > cgroups.generation + 1 || rewalkPending ||
+                   (newPass && cgroups.refreshes % cgroupRewalkEvery == 0);
+    if (!rebuild && snap.generation != cgroups.generation) {
+        // Follow the process snapshot's changes
+        for (const ProcChange &change : snap.changes.removed) {
+            auto it = cgroups.procGroup.find(change.key);
+            if (it == cgroups.procGroup.end()) continue;
+            cgroups.groups[it->second].processes--;
+            cgroups.procGroup.erase(it);
+        }
+        char buf[4096];
+        string path;
+        for (const ProcChange &change : snap.changes.added) {
+            ssize_t n = readFd(openPidFile(procDirFd(), change.key.pid, "cgroup"), buf, sizeof(buf));
+            if (n <= 0 || !parseCgroupPath(buf, n, path)) continue;
+            auto it = cgroups.index.find(path);
+            if (it != cgroups.index.end()) {
+                cgroups.procGroup[change.key] = it->second;
+                cgroups.groups[it->second].processes++;
+            } else if (unknownPaths.insert(path).second) {
+                rebuild = true;
+                break;
+            }
+        }
+    }
+    if (rebuild) {
+        rewalkPending = false;
+        rewalk(snap);
+    }
+    cgroups.generation = snap.generation;
+    // Membership follows every refresh; the stat files once per complete pass
+    if (!newPass) return;
+    cgroups.passes = snap.passes;
+
+    double timestamp = monotonicSeconds();
+    double elapsed = cgroups.timestamp > 0 ? timestamp - cgroups.timestamp : 0.0;
+    cgroups.timestamp = timestamp;
+    double cpuScale = elapsed > 0 ? 100.0 / (elapsed * 1e6) : 0.0;
+    if (procOptions.solarisMode) {
+        cpuScale /= sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    for (uint32_t id : cgroups.order) {
+        readStats(cgroups.groups[id], elapsed, cpuScale);
+    }
+    cgroups.refreshes++;
+}
+
+const CgroupSnapshot &getCgroups()
+{
+    return cgroups;
+}
@@ -32,9 +32,40 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <map>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
+// ProcFile keeps a /proc or /sys file open for the lifetime of the reader
+// and re-reads it from offset 0 with pread into a buffer it owns, so a
+// sample costs one syscall and no allocation once the buffer has grown.
+class ProcFile
+{
+public:
+    explicit ProcFile(const char *path);
+    ~ProcFile();
+    ProcFile(const ProcFile &) = delete;
+    ProcFile &operator=(const ProcFile &) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    // Re-read the file; false if it is not open or the read failed.
+    bool read();
+    // NUL-terminated contents of the last read().
+    const char *data() const { return buffer.data(); }
+    size_t size() const { return length; }
+    // Next line of the last read(), NUL-terminated in place, or nullptr at
+    // the end. Lines can only be walked once per read().
+    char *nextLine();
+
+private:
+    int fd;
+    vector<char> buffer;
+    size_t length;
+    size_t cursor;
+};
+
 struct CPUStats
 {
     long long int user;
@@ -55,11 +86,22 @@ struct Proc
     int pid;
     string name;
     char state;
+    int ppid;
     long long int vsize;
     long long int rss;
     long long int utime;
     long long int stime;
+    unsigned long long int starttime;
+    long long int blkioTicks;  // time waiting on block I/O (needs delay accounting)
+    long long int minflt, majflt;
+    uid_t uid;  // owner of /proc/[pid], i.e. the effective uid
+    // From /proc/[pid]/status, only read when a column needs them; -1 otherwise
+    long long int ctxtVoluntary, ctxtInvoluntary;
     float cpu_percent;
+    float io_wait;  // blkioTicks over the last interval, like cpu_percent
+    // Per second over the last interval
+    float minfltRate, majfltRate;
+    float ctxtVoluntaryRate, ctxtInvoluntaryRate;
 };
 
 struct IP4
@@ -98,6 +140,7 @@ struct TX
 };
 
 // System stats
+double monotonicSeconds();  // CLOCK_MONOTONIC, for intervals between samples
 string CPUinfo();
 const char *getOsName();
 string getUsername();
@@ -108,6 +151,66 @@ struct TaskCounts {
 TaskCounts getTaskCounts();
 CPUStats getCPUStats();
 float calculateCPUUsage();
+// One "cpu" or "cpuN" line of /proc/stat; `cpu` is -1 for the aggregate.
+bool parseCpuStatLine(const char *line, int &cpu, CPUStats &stats);
+// Where CPU time went, as shares of each interval. Guest time is already
+// counted in user and nice, so it is not a component of its own.
+enum CpuComponent {
+    CPU_USER,
+    CPU_NICE,
+    CPU_SYSTEM,
+    CPU_IRQ,
+    CPU_SOFTIRQ,
+    CPU_STEAL,
+    CPU_IOWAIT,
+    CPU_IDLE,
+    CPU_COMPONENTS
+};
+const char *cpuComponentName(int component);
+// Aggregate and per-core counters from a single pass over /proc/stat.
+// Capacity is fixed so sampling never allocates; cores past it are ignored.
+// The per-core counters are stored column-major, one row of all cores per
+// component, as each line is parsed.
+struct CoreStats {
+    static const int maxCores = 256;
+    int count;  // highest cpuN seen plus one; offline cores stay zero
+    CPUStats total;
+    long long ticks[CPU_COMPONENTS][maxCores];
+
+    void setCore(int core, const CPUStats &values);
+};
+bool readCoreStats(CoreStats &stats);
+// Busy % and the per-component breakdown (in %, summing to 100, or all 0
+// without an interval) of the aggregate and of every core
+struct CoreUsage {
+    int count;
+    float total;
+    float cores[CoreStats::maxCores];
+    float totalBreakdown[CPU_COMPONENTS];
+    float breakdown[CPU_COMPONENTS][CoreStats::maxCores];
+};
+// Deltas between two samples; the per-core part works on whole rows of
+// all maxCores cores, straight from CoreStats::ticks, so the compiler can
+// vectorize it.
+void computeCoreUsage(const CoreStats &prev, const CoreStats &curr, CoreUsage &usage);
+// Reads /proc/stat and computes the usage since the previous call
+const CoreUsage &sampleCoreUsage();
+// Recent aggregate breakdowns, one ring-buffered series per component
+struct CpuBreakdownHistory {
+    static const int capacity = 600;
+    int size = 0;
+    int next = 0;  // slot the next sample goes to
+    float series[CPU_COMPONENTS][capacity];
+
+    void push(const float *breakdown)
+    {
+        for (int c = 0; c < CPU_COMPONENTS; c++) series[c][next] = breakdown[c];
+        next = (next + 1) % capacity;
+        if (size < capacity) size++;
+    }
+    // The i-th oldest sample
+    float at(int component, int i) const { return series[component][(next - size + i + capacity) % capacity]; }
+};
 float getThermalTemp();
 struct FanInfo {
     bool enabled;
@@ -118,16 +221,467 @@ FanInfo getFanInfo();
 
 // Memory and processes
 vector<Proc> getProcesses();
+// Parser for one /proc/[pid]/stat line; `buf` need not be NUL-terminated.
+enum ProcStatError {
+    PROC_STAT_OK = 0,
+    PROC_STAT_BAD_PID,
+    PROC_STAT_NO_COMM,
+    PROC_STAT_BAD_STATE,
+    PROC_STAT_BAD_FIELD,
+    PROC_STAT_TRUNCATED,
+};
+// Field 42 (block I/O delay) is only looked for with `blkio`: it stays zero
+// unless delay accounting is on, and reaching it means stepping over 17
+// other fields.
+ProcStatError parseProcStat(const char *buf, size_t len, Proc &proc, bool blkio = true);
+// voluntary_ctxt_switches and nonvoluntary_ctxt_switches from
+// /proc/[pid]/status; false if either is missing.
+bool parseProcStatusCtxt(const char *buf, size_t len, long long &voluntary, long long &involuntary);
+const char *procStatErrorName(ProcStatError err);
+// kernel.task_delayacct; without it the block I/O delay field stays zero
+bool delayAccountingEnabled();
 struct MemInfo {
     long long total, available, used;
 };
 MemInfo getMemInfo();
 MemInfo getSwapInfo();
+long getPageSize();  // bytes per page, for the page counts in /proc/[pid]/stat
 struct DiskInfo {
     long long total, used, available;
 };
 DiskInfo getDiskInfo();
 
+// Process snapshot: a single /proc scan per sample tick that feeds both
+// the task counts and the process table.
+//
+// The table is persistent: each scan is applied as a diff, and a process is
+// identified by (pid, starttime) so a recycled pid shows up as one removal
+// plus one addition. A process keeps its table row for its whole lifetime,
+// so rows are stable handles; freed rows are reused by later additions.
+// `changes` lists what the last refresh did; consumers that skipped a
+// refresh (their `generation` is not the previous one) must rebuild from
+// `table` instead.
+struct ProcKey {
+    int pid;
+    unsigned long long starttime;
+    bool operator==(const ProcKey &other) const
+    {
+        return pid == other.pid && starttime == other.starttime;
+    }
+};
+struct ProcKeyHash {
+    size_t operator()(const ProcKey &key) const
+    {
+        return hash<unsigned long long>()(((unsigned long long)key.pid << 40) ^ key.starttime);
+    }
+};
+struct ProcChange {
+    ProcKey key;
+    uint32_t row;
+};
+struct ProcChanges {
+    vector<ProcChange> added, removed, updated;
+};
+// Interned process names, reference counted by the rows that use them.
+// Each name also keeps a lowercase copy, and a trigram index over the
+// lowercase names answers substring queries without visiting every name.
+struct NameTable {
+    vector<string> names;
+    vector<string> lower;
+    vector<uint32_t> refs;
+    vector<uint32_t> freeIds;
+    unordered_map<string, uint32_t> ids;
+    // trigram -> ids of names containing it. Entries of released names are
+    // left in place (queries verify every candidate) until they outnumber
+    // the live ones and the index is rebuilt.
+    unordered_map<uint32_t, vector<uint32_t>> trigrams;
+    vector<uint32_t> indexed;  // id -> distinct trigrams it has in the index
+    size_t liveTrigrams = 0, staleTrigrams = 0;
+
+    uint32_t intern(const string &name);
+    void release(uint32_t id);
+    const string &get(uint32_t id) const { return names[id]; }
+    // Does name `id` contain `lowerQuery`?
+    bool matches(uint32_t id, const string &lowerQuery) const;
+    // Set result[id] for every live name containing `lowerQuery`.
+    void matchAll(const string &lowerQuery, vector<uint8_t> &result) const;
+
+private:
+    void indexTrigrams(uint32_t id);
+};
+// Columnar process table: one contiguous array per field with rows aligned
+// across columns, so sorts and filters only touch the columns they need.
+// Rows of exited processes stay in place with alive[row] == 0 until reused.
+struct ProcTable {
+    vector<int> pid;
+    vector<unsigned long long> starttime;
+    vector<char> state;
+    vector<int> ppid;
+    vector<uid_t> uid;
+    vector<long long> utime, stime;
+    vector<long long> vsize, rss;
+    vector<float> cpuPercent;
+    vector<long long> blkioTicks;
+    vector<float> ioWait;
+    vector<long long> minflt, majflt, ctxtVoluntary, ctxtInvoluntary;
+    vector<float> minfltRate, majfltRate, ctxtVoluntaryRate, ctxtInvoluntaryRate;
+    vector<uint32_t> nameId;  // into ProcSnapshot::names
+    vector<uint8_t> alive;
+    vector<uint32_t> freeRows;
+
+    size_t size() const { return pid.size(); }  // rows, including free ones
+    size_t count() const { return pid.size() - freeRows.size(); }
+    ProcKey key(size_t row) const { return {pid[row], starttime[row]}; }
+    uint32_t insert(const Proc &proc, uint32_t name);
+    void set(uint32_t row, const Proc &proc);
+    void erase(uint32_t row);
+};
+struct ProcSnapshot {
+    unsigned long generation;  // bumped by every refresh
+    // Complete passes so far. Anything sampled once per tick (histories,
+    // rates, side files) keys on this rather than on `generation`.
+    unsigned long passes;
+    double timestamp;  // CLOCK_MONOTONIC seconds of the last refresh
+    // A refresh may stop at the scan budget and leave the rest of the pass
+    // to the next one: rows not yet re-read keep their previous values.
+    float scanProgress;  // fraction of the current pass read; 1 when complete
+    double completedAt;  // CLOCK_MONOTONIC start of the last complete pass
+    TaskCounts tasks;
+    ProcTable table;
+    NameTable names;
+    unordered_map<ProcKey, uint32_t, ProcKeyHash> index;  // key -> table row
+    ProcChanges changes;
+};
+void refreshProcSnapshot();
+const ProcSnapshot &getProcSnapshot();
+
+// Process table sort order, kept across refreshes and repaired from each
+// refresh's change set instead of re-sorting every row.
+enum ProcSortColumn {
+    PROC_SORT_PID,
+    PROC_SORT_NAME,
+    PROC_SORT_USER,  // by uid, which groups each user's processes
+    PROC_SORT_STATE,
+    PROC_SORT_CPU,
+    PROC_SORT_MEMORY,
+    PROC_SORT_MINFLT,
+    PROC_SORT_MAJFLT,
+    PROC_SORT_CTXT_VOLUNTARY,
+    PROC_SORT_CTXT_INVOLUNTARY,
+};
+struct ProcSortKey {
+    ProcSortColumn column;
+    bool descending;
+    bool operator==(const ProcSortKey &other) const
+    {
+        return column == other.column && descending == other.descending;
+    }
+};
+struct ProcOrder {
+    vector<uint32_t> rows;  // live table rows in sort order
+    vector<ProcSortKey> keys;
+    unsigned long generation = 0;
+    unsigned long version = 0;  // bumped whenever `rows` changes
+    // Scratch buffers reused between updates
+    vector<uint8_t> dirty;
+    vector<uint32_t> moved, merged;
+};
+// Bring `order` up to date with `snap`; returns true if it fully re-sorted.
+bool updateProcOrder(ProcOrder &order, const ProcSnapshot &snap, const vector<ProcSortKey> &keys);
+
+// Name filter over a ProcOrder. The per-name match results and the
+// filtered rows are cached, and only recomputed when the filter text, the
+// order or the names of added/updated rows change.
+struct ProcFilter {
+    string query;  // lowercase
+    unsigned long generation = 0;
+    unsigned long orderVersion = 0;
+    vector<uint8_t> nameMatches;  // by name id
+    vector<uint32_t> rows;        // matching rows in sort order
+};
+// Returns the rows of `order` whose name contains `text` (case-insensitive).
+const vector<uint32_t> &updateProcFilter(ProcFilter &filter, const ProcSnapshot &snap, const ProcOrder &order,
+                                         const char *text);
+// Process tree over table rows, with subtree totals (a row plus all of its
+// descendants). Maintained from each refresh's change set: additions,
+// exits and reparenting only touch the rows involved and their ancestors.
+struct ProcTree {
+    static constexpr uint32_t none = UINT32_MAX;
+
+    unsigned long generation = 0;
+    unordered_map<int, uint32_t> rowOfPid;  // live pid -> row
+    vector<uint32_t> parent;                // row -> parent row, or none
+    vector<vector<uint32_t>> children;      // unordered; rows leave by swap-remove
+    vector<uint32_t> roots;                 // live rows without a parent, unordered
+    vector<uint32_t> slot;                  // row -> position in its parent's children or in roots
+    // Values as last applied, so exits and updates can be undone
+    vector<int> ppid;
+    vector<float> cpu;
+    vector<long long> rss;
+    vector<double> subtreeCpu;
+    vector<long long> subtreeRss;  // pages
+};
+// Bring `tree` up to date with `snap`; returns true if it was rebuilt.
+bool updateProcTree(ProcTree &tree, const ProcSnapshot &snap);
+// Selected processes, keyed by identity so a selection follows its process
+// through re-sorts and is dropped when the process exits. The totals and
+// a short CPU history per process are maintained by updateProcSelection.
+struct ProcSelection {
+    static const size_t historyLength = 120;  // samples kept per process
+
+    unordered_map<ProcKey, uint32_t, ProcKeyHash> rows;  // key -> table row
+    unordered_map<ProcKey, vector<float>, ProcKeyHash> history;
+    unsigned long generation = 0;
+    unsigned long passes = 0;  // pass of the last history sample
+    bool dirty = false;  // membership changed since the totals were summed
+    float cpuPercent = 0;
+    long long rss = 0;  // pages
+
+    bool contains(const ProcKey &key) const { return rows.count(key) != 0; }
+};
+// Click on `row`: toggles it when `additive`, otherwise selects only it.
+void selectProc(ProcSelection &sel, const ProcSnapshot &snap, uint32_t row, bool additive);
+// Drop exited processes and refresh the totals and history; O(selected).
+void updateProcSelection(ProcSelection &sel, const ProcSnapshot &snap);
+// Processes to read smaps_rollup for: the selection, plus the `topN`
+// largest by RSS.
+void smapsTargets(const ProcSnapshot &snap, const ProcSelection &sel, size_t topN, vector<ProcKey> &keys);
+// Heaviest consumers per metric, found with one bounded heap per metric in
+// a single pass over the table rather than by sorting every process.
+enum ProcTopMetric { PROC_TOP_CPU, PROC_TOP_RSS, PROC_TOP_IO_WAIT, PROC_TOP_METRICS };
+struct ProcTopN {
+    size_t n = 10;
+    unsigned long generation = 0;
+    vector<uint32_t> rows[PROC_TOP_METRICS];  // heaviest first; zero values left out
+};
+// Recompute `top` when `snap` has refreshed since the last call.
+void updateProcTopN(ProcTopN &top, const ProcSnapshot &snap);
+// Threads of one process, read from <root>/<pid>/task/<tid>/stat with the
+// process stat parser. Only processes expanded in the table are read, and
+// only while they are on screen, so the cost follows what is displayed.
+struct ThreadList {
+    ProcKey key;                    // owning process
+    unsigned long passes = 0;       // snapshot pass of the last read
+    double timestamp = 0;           // CLOCK_MONOTONIC seconds of the last read
+    vector<Proc> threads;           // Proc::pid holds the tid
+    unordered_map<ProcKey, long long, ProcKeyHash> ticks;  // (tid, starttime) -> utime+stime
+};
+// Re-read the threads and their CPU% over the interval since the previous
+// read. Returns false once the process has exited.
+bool refreshThreadList(ThreadList &list, const char *root);
+// Counters from /proc/[pid]/io
+struct ProcIoCounters {
+    long long rchar, wchar, syscr, syscw, readBytes, writeBytes, cancelledWriteBytes;
+};
+enum ProcIoStatus {
+    PROC_IO_OK,
+    PROC_IO_GONE,    // the process exited
+    PROC_IO_DENIED,  // another user's process without CAP_SYS_PTRACE
+};
+// False if any of the counters the table shows is missing.
+bool parseProcIo(const char *buf, size_t len, ProcIoCounters &io);
+ProcIoStatus readProcIo(const char *root, int pid, ProcIoCounters &io);
+// Per-process I/O rates, sampled only for the rows drawn last frame and
+// the selection, at most `budget` files per refresh (stalest first).
+// Processes whose file is denied are marked and never read again.
+struct ProcIoRates {
+    struct Entry {
+        unsigned long generation = 0;  // refresh of the last read
+        double timestamp = 0;
+        bool denied = false;
+        bool hasRates = false;  // two reads so far
+        ProcIoCounters counters = {};
+        float readBytes = 0, writeBytes = 0, syscr = 0, syscw = 0;  // per second
+    };
+    unordered_map<ProcKey, Entry, ProcKeyHash> entries;
+    vector<uint32_t> wanted;  // rows drawn since the last round of reads, each once
+    vector<unsigned long> wantedRound;  // row -> round it was last wanted in
+    unsigned long round = 1;  // bumped by every round of reads
+    unsigned long generation = 0;
+    unsigned long passes = 0;  // pass of the last round of reads
+    int budget = 64;
+    int readsLastRefresh = 0;
+
+    const Entry *find(const ProcKey &key) const
+    {
+        auto it = entries.find(key);
+        return it == entries.end() ? nullptr : &it->second;
+    }
+    // Ask for `row` in the next round of reads. Called for every drawn row
+    // on every frame, so repeats are dropped here and `wanted` stays
+    // bounded by the rows on screen.
+    void want(uint32_t row)
+    {
+        if (row >= wantedRound.size()) wantedRound.resize(row + 1, 0);
+        if (wantedRound[row] == round) return;
+        wantedRound[row] = round;
+        wanted.push_back(row);
+    }
+};
+// Drop exited processes on every new snapshot generation; once per
+// complete pass, read the wanted and selected rows' files within the
+// budget. Call once per frame.
+void updateProcIoRates(ProcIoRates &io, const ProcSnapshot &snap, const ProcSelection &sel);
+// Processes expanded into their threads in the table
+struct ProcThreads {
+    unordered_map<ProcKey, ThreadList, ProcKeyHash> lists;
+    vector<pair<uint32_t, int>> lines;  // (row, thread index or -1) per table line
+};
+// Process table body, between BeginTable and EndTable. Only the rows in
+// view are formatted and submitted (ImGuiListClipper), so the cost of a
+// frame does not grow with the number of processes.
+void drawProcessRows(const ProcSnapshot &snap, const vector<uint32_t> &rows, long long ramTotal,
+                     ProcSelection &selection, ProcThreads &threads, ProcIoRates &io);
+// Tree tab: which nodes are open, and the lines they expand to. The roots
+// and the children of open nodes are sorted once per complete pass; the
+// refreshes in between only drop rows that left a list and append the ones
+// that joined it, and opening or closing a node only lays the lines out.
+struct ProcTreeView {
+    unordered_set<ProcKey, ProcKeyHash> open;
+    vector<pair<uint32_t, int>> lines;  // (row, depth)
+    unsigned long generation = 0;
+    unsigned long passes = 0;  // pass the lists were last sorted in
+    bool dirty = true;  // a node was opened or closed since the layout
+    vector<uint32_t> roots;  // by subtree CPU
+    unordered_map<uint32_t, vector<uint32_t>> order;  // open row -> children by subtree CPU
+    vector<unsigned long> kept;  // row -> generation it was last kept in a list
+};
+// Bring `view.lines` up to date with `tree` and the open nodes.
+void layoutProcTree(ProcTreeView &view, const ProcSnapshot &snap, const ProcTree &tree);
+// Process tree body, between BeginTable and EndTable; clipped like the
+// table, with children ordered by subtree CPU.
+void drawProcessTree(const ProcSnapshot &snap, const ProcTree &tree, ProcTreeView &view);
+// Three side-by-side top-N lists (CPU, RSS, block I/O delay)
+void drawTopConsumers(const ProcSnapshot &snap, const ProcTopN &top);
+struct ProcOptions {
+    bool solarisMode;      // CPU% normalized by core count (top's Irix mode off)
+    int sampleIntervalMs;  // how often the UI loop refreshes the snapshot
+    int scanThreads;       // workers parsing /proc/[pid]/stat in parallel
+    bool useProcEvents;    // track pids via the netlink proc connector
+    int smapsBudgetMs;     // background smaps_rollup reading per round
+    int scanBudgetUs;      // /proc/[pid]/stat reading per refresh; 0 reads every pid
+    bool readStatus;       // also read /proc/[pid]/status, for context switches
+    int userNegativeTtlS;  // before a uid with no passwd entry is looked up again
+};
+extern ProcOptions procOptions;
+int defaultScanThreads();
+// Per-pid files are opened relative to a directory fd rather than by
+// absolute path. procDirFd() is /proc, opened once and kept.
+int procDirFd();
+int openPidFile(int dirfd, int pid, const char *file, int flags = 0);
+// Numeric entries of `root`, read with getdents64 into a reused buffer
+void listPids(const char *root, vector<int> &pids);
+// Parse <root>/[pid]/stat for pids[begin..], sharded across `threads`
+// workers, stopping early once CLOCK_MONOTONIC passes `deadline` (0 for no
+// deadline). Returns the index of the first pid not read. Pids that no
+// longer exist are appended to `gone`, if given. `blkio` is passed on to
+// parseProcStat.
+size_t scanProcStats(const char *root, const vector<int> &pids, int threads, vector<Proc> &out, size_t begin = 0,
+                     double deadline = 0, vector<int> *gone = nullptr, bool blkio = true);
+
+// Proportional memory from /proc/[pid]/smaps_rollup, in bytes. PSS splits
+// each shared page between the processes mapping it, so it sums to real
+// usage where RSS counts shared pages once per process; USS is the memory
+// only this process holds.
+struct SmapsRollup {
+    long long rss, pss, shared, uss, swap, swapPss;
+};
+bool parseSmapsRollup(const char *buf, size_t len, SmapsRollup &out);
+// Read /proc/[pid]/smaps_rollup for `key`. False if the process exited, its
+// pid now belongs to another process, or its smaps are not readable.
+bool readSmapsRollup(const ProcKey &key, SmapsRollup &out);
+// smaps_rollup walks the whole address space, milliseconds for a large
+// process, so it is read on a background thread. requestSmaps() sets the
+// processes to read and starts a round; the worker spends at most
+// procOptions.smapsBudgetMs per round, resuming where it stopped on the
+// next one. pollSmaps() publishes finished reads to getSmaps() and drops
+// processes that are no longer requested.
+void requestSmaps(const vector<ProcKey> &keys);
+void pollSmaps();
+const unordered_map<ProcKey, SmapsRollup, ProcKeyHash> &getSmaps();
+
+// uid -> user name. getpwuid_r can go out to LDAP or SSSD, so names are
+// resolved on a background thread and cached; userName() never blocks and
+// returns the uid as a number until the name is known, or for good when
+// there is no passwd entry (retried after procOptions.userNegativeTtlS).
+string userName(uid_t uid);
+struct UserCacheStats {
+    size_t entries, pending;
+    unsigned long lookups;  // getpwuid_r calls made
+};
+UserCacheStats getUserCacheStats();
+
+// Event-driven process tracking via the kernel proc connector
+// (NETLINK_CONNECTOR). Falls back to listing /proc when the connector
+// cannot be joined, e.g. without CAP_NET_ADMIN.
+enum ProcTrackMode {
+    PROC_TRACK_SCAN,
+    PROC_TRACK_NETLINK,
+};
+ProcTrackMode getProcTrackMode();
+const string &getProcTrackError();  // why netlink mode was refused
+bool openProcEvents(string &error);
+void closeProcEvents();
+// Apply pending fork/exec/comm events to `live`; false if events were lost.
+bool readProcEvents(unordered_set<int> &live);
+
+// Accounting for tasks that exit between samples, from taskstats exit
+// records (generic netlink, needs CAP_NET_ADMIN), aggregated by command.
+struct ExitedCommand {
+    string name;
+    long long tasks = 0;
+    long long cpuUsec = 0;     // utime + stime
+    long long maxRssKB = 0;    // largest RSS high-water mark
+    long long readBytes = 0;
+    long long writeBytes = 0;
+    double lastExit = 0.0;     // CLOCK_MONOTONIC seconds
+};
+bool openTaskExits(string &error);
+void closeTaskExits();
+bool taskExitsActive();
+void pollTaskExits();  // non-blocking; call every frame
+const vector<ExitedCommand> &getExitedCommands();
+long long getTaskExitOverflows();  // receive buffer overruns (records lost)
+void clearExitedCommands();
+
+// cgroup v2 hierarchy (/sys/fs/cgroup, or /sys/fs/cgroup/unified on hybrid
+// hosts). The directory walk is cached: it is repeated every
+// cgroupRewalkEvery refreshes, when a group disappears, or when a new
+// process turns up in an unknown group. Otherwise a refresh only re-reads
+// the stat files of the known groups. Groups keep their index for as long
+// as they exist, so rates are computed against their previous read.
+struct CgroupStats {
+    string path;  // relative to the root: "/" or "/system.slice/..."
+    int depth;
+    bool alive;
+    bool sampled;  // read at least once, so the rates have a baseline
+    // Counters as last read
+    long long usageUsec, throttledUsec;
+    long long memoryCurrent, anon, file;
+    long long readBytes, writeBytes, rios, wios;  // io.stat, summed over devices
+    float pressureSome10;                         // cpu.pressure "some avg10", %
+    // Rates over the last interval
+    float cpuPercent, readRate, writeRate;
+    int processes;  // from the process snapshot
+};
+struct CgroupSnapshot {
+    string root;  // empty if there is no cgroup v2 hierarchy
+    unsigned long generation;  // process snapshot generation attached
+    unsigned long passes;      // process snapshot pass the stats were read in
+    unsigned long refreshes;
+    double timestamp;
+    vector<CgroupStats> groups;
+    vector<uint32_t> order;  // alive groups in walk order (parents first)
+    unordered_map<string, uint32_t> index;  // path -> group
+    unordered_map<ProcKey, uint32_t, ProcKeyHash> procGroup;
+};
+// Attach the processes of `snap`, and re-read the groups once per complete
+// pass. `root` overrides the hierarchy's location (tests); nullptr finds it.
+void refreshCgroups(const ProcSnapshot &snap, const char *root = nullptr);
+const CgroupSnapshot &getCgroups();
+// The v2 path in a /proc/[pid]/cgroup file (its "0::" line).
+bool parseCgroupPath(const char *buf, size_t len, string &path);
+
 // Network
 Networks getNetworks();
 struct NetStats {
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <string>
 #include <cctype>
+#include <thread>
 
 /*
 NOTE : You are free to change the code as you wish, the main objective is to make the
@@ -44,6 +45,147 @@ using namespace gl;
 #include IMGUI_IMPL_OPENGL_LOADER_CUSTOM
 #endif
 
+// Per-core CPU usage over time. Each sample is one texel column written
+// into a ring of columns with glTexSubImage2D, and the whole history is
+// drawn as a single quad: the texture repeats horizontally, so starting
+// the U range at the oldest column unrolls the ring.
+class CoreHeatmap
+{
+public:
+    // The texture lives as long as the GL context; it is not deleted here
+    // because static destructors run after the context is gone
+    static const int samples = 600;
+
+    void push(const CoreUsage &usage)
+    {
+        if (!texture) create();
+        cores = min(usage.count, (int)CoreStats::maxCores);
+        for (int core = 0; core < cores; core++) {
+            column[core] = heatColor(usage.cores[core]);
+            latest[core] = usage.cores[core];
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, head, 0, 1, cores, GL_RGBA, GL_UNSIGNED_BYTE, column);
+        head = (head + 1) % samples;
+    }
+
+    void draw(float height)
+    {
+        if (!texture || cores == 0) return;
+        float u0 = (float)head / samples;
+        float v1 = (float)cores / CoreStats::maxCores;
+        ImVec2 size(ImGui::GetContentRegionAvail().x, height);
+        ImGui::Image((ImTextureID)(intptr_t)texture, size, ImVec2(u0, 0.0f), ImVec2(u0 + 1.0f, v1));
+        if (ImGui::IsItemHovered()) {
+            int core = (int)((ImGui::GetIO().MousePos.y - ImGui::GetItemRectMin().y) / size.y * cores);
+            core = max(0, min(core, cores - 1));
+            ImGui::SetTooltip("cpu%d: %.0f%%", core, latest[core]);
+        }
+    }
+
+private:
+    void create()
+    {
+        // Transparent until the first samples arrive
+        vector<uint32_t> blank((size_t)samples * CoreStats::maxCores, 0);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, samples, CoreStats::maxCores, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     blank.data());
+    }
+
+    // Idle cores are dark blue, busy ones bright red
+    static uint32_t heatColor(float percent)
+    {
+        float t = max(0.0f, min(percent / 100.0f, 1.0f));
+        float r, g, b;
+        ImGui::ColorConvertHSVtoRGB(0.66f * (1.0f - t), 0.9f, 0.25f + 0.75f * t, r, g, b);
+        return IM_COL32((int)(r * 255), (int)(g * 255), (int)(b * 255), 255);
+    }
+
+    GLuint texture = 0;
+    int head = 0;
+    int cores = 0;
+    uint32_t column[CoreStats::maxCores];
+    float latest[CoreStats::maxCores];
+};
+
+// Colors of the CPU time components; idle is left as background
+static const ImU32 cpuComponentColors[CPU_COMPONENTS] = {
+    IM_COL32(80, 200, 80, 255),   // user
+    IM_COL32(80, 200, 200, 255),  // nice
+    IM_COL32(220, 70, 70, 255),   // system
+    IM_COL32(240, 150, 40, 255),  // irq
+    IM_COL32(230, 220, 60, 255),  // softirq
+    IM_COL32(220, 80, 220, 255),  // steal
+    IM_COL32(70, 110, 240, 255),  // iowait
+    IM_COL32(0, 0, 0, 0),         // idle
+};
+
+// Stacked area chart of the aggregate breakdown, oldest sample on the
+// left, with a legend of the latest values
+static void drawCpuBreakdown(const CpuBreakdownHistory &history, float height)
+{
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImVec2 size(ImGui::GetContentRegionAvail().x, height);
+    ImDrawList *draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(20, 20, 20, 255));
+    float step = size.x / (CpuBreakdownHistory::capacity - 1);
+    float x0 = origin.x + size.x - (history.size - 1) * step;
+    for (int i = 0; i + 1 < history.size; i++) {
+        float a = 0, b = 0;  // stacked height so far at both ends of the segment
+        float xa = x0 + i * step, xb = xa + step;
+        for (int c = 0; c < CPU_IDLE; c++) {
+            float na = a + history.at(c, i), nb = b + history.at(c, i + 1);
+            if (na > a || nb > b) {
+                draw->AddQuadFilled(ImVec2(xa, origin.y + size.y * (1 - a / 100)),
+                                    ImVec2(xa, origin.y + size.y * (1 - na / 100)),
+                                    ImVec2(xb, origin.y + size.y * (1 - nb / 100)),
+                                    ImVec2(xb, origin.y + size.y * (1 - b / 100)), cpuComponentColors[c]);
+            }
+            a = na;
+            b = nb;
+        }
+    }
+    ImGui::Dummy(size);
+
+    for (int c = 0; c < CPU_IDLE; c++) {
+        if (c > 0) ImGui::SameLine();
+        float latest = history.size > 0 ? history.at(c, history.size - 1) : 0.0f;
+        ImGui::TextColored(ImColor(cpuComponentColors[c]), "%s %.1f%%", cpuComponentName(c), latest);
+    }
+}
+
+// One stacked bar per core for the latest sample
+static void drawCoreBreakdown(const CoreUsage &usage, float height)
+{
+    ImGui::BeginChild("CoreBreakdown", ImVec2(0, height));
+    const float barHeight = ImGui::GetTextLineHeight();
+    ImGuiListClipper clipper;
+    clipper.Begin(usage.count);
+    while (clipper.Step()) {
+        for (int core = clipper.DisplayStart; core < clipper.DisplayEnd; core++) {
+            ImGui::Text("cpu%-3d", core);
+            ImGui::SameLine();
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            float width = ImGui::GetContentRegionAvail().x;
+            ImDrawList *draw = ImGui::GetWindowDrawList();
+            float x = origin.x;
+            for (int c = 0; c < CPU_IDLE; c++) {
+                float w = width * usage.breakdown[c][core] / 100;
+                draw->AddRectFilled(ImVec2(x, origin.y), ImVec2(x + w, origin.y + barHeight), cpuComponentColors[c]);
+                x += w;
+            }
+            ImGui::Dummy(ImVec2(width, barHeight));
+        }
+    }
+    ImGui::EndChild();
+}
+
 // systemWindow, display information for the system monitorization
 void systemWindow(const char *id, ImVec2 size, ImVec2 position)
 {
@@ -56,13 +198,20 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::Text("User: %s", getUsername().c_str());
     ImGui::Text("Hostname: %s", getHostname().c_str());
     
-    TaskCounts tasks = getTaskCounts();
+    const TaskCounts &tasks = getProcSnapshot().tasks;
     ImGui::Text("Total Tasks: %d", tasks.total);
     ImGui::Text("Running: %d, Sleeping: %d, Stopped: %d, Zombie: %d", 
                 tasks.running, tasks.sleeping, tasks.stopped, tasks.zombie);
     
     ImGui::Text("CPU: %s", CPUinfo().c_str());
     
+    ImGui::Separator();
+
+    // Heaviest consumers, kept visible outside the tabs
+    static ProcTopN top;
+    updateProcTopN(top, getProcSnapshot());
+    drawTopConsumers(getProcSnapshot(), top);
+
     ImGui::Separator();
     
     // Tabbed section for CPU, Fan, Thermal
@@ -71,18 +220,25 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
         // CPU Tab
         if (ImGui::BeginTabItem("CPU")) {
             static vector<float> cpuHistory;
+            static CoreHeatmap heatmap;
+            static CpuBreakdownHistory breakdownHistory;
+            static bool perCore = false;
             static bool animate = true;
             static float fps = 5.0f;  // Default to 5 FPS for reasonable update rate
             static float yScale = 100.0f;
             static Uint32 lastUpdateTime = 0;
             static float lastCpuUsage = 0.0f;
+            static const CoreUsage *lastCoreUsage = nullptr;
 
             Uint32 currentTime = SDL_GetTicks();
             float updateInterval = 1000.0f / fps;  // Convert FPS to milliseconds
             
             // Only update CPU usage at the specified FPS rate
             if (currentTime - lastUpdateTime >= updateInterval) {
-                lastCpuUsage = calculateCPUUsage();
+                // One /proc/stat pass gives the total and every core
+                const CoreUsage &usage = sampleCoreUsage();
+                lastCpuUsage = usage.total;
+                lastCoreUsage = &usage;
                 lastUpdateTime = currentTime;
                 
                 if (animate) {
@@ -90,6 +246,8 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
                     if (cpuHistory.size() > 100) {
                         cpuHistory.erase(cpuHistory.begin());
                     }
+                    heatmap.push(usage);
+                    breakdownHistory.push(usage.totalBreakdown);
                 }
             }
             
@@ -101,6 +259,15 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
                 ImGui::PlotLines("CPU Usage", cpuHistory.data(), cpuHistory.size(), 0, 
                                ("CPU: " + to_string((int)lastCpuUsage) + "%").c_str(), 0.0f, yScale, ImVec2(0, 80));
             }
+            // One row per core, newest sample on the right
+            heatmap.draw(120.0f);
+
+            // Where the time went: steal and iowait matter most on VMs
+            drawCpuBreakdown(breakdownHistory, 80.0f);
+            ImGui::Checkbox("Per-core breakdown", &perCore);
+            if (perCore && lastCoreUsage) {
+                drawCoreBreakdown(*lastCoreUsage, 150.0f);
+            }
             
             ImGui::EndTabItem();
         }
@@ -220,77 +387,300 @@ void memoryProcessesWindow(const char *id, ImVec2 size, ImVec2 position)
     
     // Process table
     static char filter[256] = "";
-    static vector<int> selectedRows;
+    static ProcSelection selection;
     
     ImGui::Text("Process Filter:");
     ImGui::InputText("##filter", filter, sizeof(filter));
+    ImGui::Checkbox("Solaris mode (CPU % of all cores)", &procOptions.solarisMode);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(150);
+    ImGui::SliderInt("Refresh (ms)", &procOptions.sampleIntervalMs, 250, 5000);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100);
+    ImGui::SliderInt("Scan threads", &procOptions.scanThreads, 1, (int)thread::hardware_concurrency());
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(150);
+    ImGui::SliderInt("Scan budget (us)", &procOptions.scanBudgetUs, 0, 50000);
+    ImGui::Checkbox("Netlink process events", &procOptions.useProcEvents);
+    ImGui::SameLine();
+    if (getProcTrackMode() == PROC_TRACK_NETLINK) {
+        ImGui::Text("Tracking: proc connector");
+    } else if (!getProcTrackError().empty()) {
+        ImGui::Text("Tracking: /proc scan (connector unavailable: %s)", getProcTrackError().c_str());
+    } else {
+        ImGui::Text("Tracking: /proc scan");
+    }
+    
+    const ProcSnapshot &snap = getProcSnapshot();
+    updateProcSelection(selection, snap);
+    if (snap.scanProgress < 1.0f) {
+        // Some rows are still from the previous pass
+        ImGui::TextDisabled("Scanning: %.0f%% refreshed, data up to %.1f s old", snap.scanProgress * 100.0f,
+                            snap.timestamp - snap.completedAt);
+    }
+
+    // PSS/USS are read in the background once per complete pass, for the
+    // selection and optionally the largest processes
+    static bool smapsLargest = false;
+    static unsigned long smapsPass = 0;
+    if (snap.passes != smapsPass) {
+        static vector<ProcKey> smapsKeys;
+        smapsTargets(snap, selection, smapsLargest ? 10 : 0, smapsKeys);
+        requestSmaps(smapsKeys);
+        smapsPass = snap.passes;
+    }
+    pollSmaps();
+    const unordered_map<ProcKey, SmapsRollup, ProcKeyHash> &smaps = getSmaps();
+
+    if (!selection.rows.empty()) {
+        long long pss = 0;
+        for (const auto &entry : selection.rows) {
+            auto it = smaps.find(entry.first);
+            if (it != smaps.end()) pss += it->second.pss;
+        }
+        ImGui::Text("Selected: %zu processes, CPU %.1f%%, RSS %s, PSS %s", selection.rows.size(), selection.cpuPercent,
+                    formatBytes(selection.rss * getPageSize()).c_str(), formatBytes(pss).c_str());
+    }
     
     if (ImGui::BeginTabBar("ProcessTabs")) {
         if (ImGui::BeginTabItem("Processes")) {
             
-            vector<Proc> processes = getProcesses();
+            // Scrolling inside the table keeps the header visible and gives the
+            // row clipper a bounded viewport
+            if (ImGui::BeginTable("ProcessTable", 14, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable |
+                                                      ImGuiTableFlags_Sortable | ImGuiTableFlags_SortMulti |
+                                                      ImGuiTableFlags_ScrollY | ImGuiTableFlags_Hideable)) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("PID", ImGuiTableColumnFlags_None, -1.0f, PROC_SORT_PID);
+                ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_None, -1.0f, PROC_SORT_NAME);
+                ImGui::TableSetupColumn("User", ImGuiTableColumnFlags_None, -1.0f, PROC_SORT_USER);
+                ImGui::TableSetupColumn("State", ImGuiTableColumnFlags_None, -1.0f, PROC_SORT_STATE);
+                ImGui::TableSetupColumn("CPU %", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending,
+                                        -1.0f, PROC_SORT_CPU);
+                ImGui::TableSetupColumn("Memory %", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, PROC_SORT_MEMORY);
+                // Sampled for visible and selected rows only, so not sortable
+                ImGui::TableSetupColumn("Read/s", ImGuiTableColumnFlags_NoSort);
+                ImGui::TableSetupColumn("Write/s", ImGuiTableColumnFlags_NoSort);
+                ImGui::TableSetupColumn("Syscr/s", ImGuiTableColumnFlags_NoSort);
+                ImGui::TableSetupColumn("Syscw/s", ImGuiTableColumnFlags_NoSort);
+                // Optional rate columns, shown from the header's context menu
+                const ImGuiTableColumnFlags rateFlags = ImGuiTableColumnFlags_DefaultHide |
+                                                        ImGuiTableColumnFlags_PreferSortDescending;
+                ImGui::TableSetupColumn("MinFlt/s", rateFlags, -1.0f, PROC_SORT_MINFLT);
+                ImGui::TableSetupColumn("MajFlt/s", rateFlags, -1.0f, PROC_SORT_MAJFLT);
+                ImGui::TableSetupColumn("VolCsw/s", rateFlags, -1.0f, PROC_SORT_CTXT_VOLUNTARY);
+                ImGui::TableSetupColumn("InvolCsw/s", rateFlags, -1.0f, PROC_SORT_CTXT_INVOLUNTARY);
+                ImGui::TableHeadersRow();
+                // Context switches come from /proc/[pid]/status, read only while shown
+                procOptions.readStatus = (ImGui::TableGetColumnFlags(12) & ImGuiTableColumnFlags_IsEnabled) ||
+                                         (ImGui::TableGetColumnFlags(13) & ImGuiTableColumnFlags_IsEnabled);
+
+                // Keep the previous order and repair it from the refresh's
+                // change set; only a change of sort columns re-sorts everything.
+                static ProcOrder order;
+                static vector<ProcSortKey> sortKeys;
+                if (ImGuiTableSortSpecs *specs = ImGui::TableGetSortSpecs()) {
+                    if (specs->SpecsDirty) {
+                        sortKeys.clear();
+                        for (int n = 0; n < specs->SpecsCount; n++) {
+                            const ImGuiTableColumnSortSpecs &spec = specs->Specs[n];
+                            sortKeys.push_back({(ProcSortColumn)spec.ColumnUserID,
+                                                spec.SortDirection == ImGuiSortDirection_Descending});
+                        }
+                        specs->SpecsDirty = false;
+                    }
+                }
+                updateProcOrder(order, snap, sortKeys);
+                
+                static ProcFilter procFilter;
+                const vector<uint32_t> &rows = updateProcFilter(procFilter, snap, order, filter);
+                
+                static ProcThreads procThreads;
+                static ProcIoRates procIo;
+                updateProcIoRates(procIo, snap, selection);
+                drawProcessRows(snap, rows, ram.total, selection, procThreads, procIo);
+                
+                ImGui::EndTable();
+            }
             
-            if (ImGui::BeginTable("ProcessTable", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {
+            ImGui::EndTabItem();
+        }
+
+        // Parent/child hierarchy with each subtree's CPU and RSS rolled up
+        if (ImGui::BeginTabItem("Tree")) {
+            static ProcTree tree;
+            static ProcTreeView treeView;
+            updateProcTree(tree, snap);
+            if (ImGui::BeginTable("ProcessTree", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                                                    ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY)) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Name");
+                ImGui::TableSetupColumn("PID");
+                ImGui::TableSetupColumn("Children");
+                ImGui::TableSetupColumn("Subtree CPU %");
+                ImGui::TableSetupColumn("Subtree RSS");
+                ImGui::TableHeadersRow();
+                drawProcessTree(snap, tree, treeView);
+                ImGui::EndTable();
+            }
+            ImGui::EndTabItem();
+        }
+
+        // Proportional memory, which unlike RSS does not count shared pages
+        // once per process
+        if (ImGui::BeginTabItem("Memory Detail")) {
+            ImGui::Checkbox("Include the 10 largest processes by RSS", &smapsLargest);
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(120);
+            ImGui::SliderInt("Read budget (ms)", &procOptions.smapsBudgetMs, 5, 500);
+            if (ImGui::BeginTable("SmapsTable", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {
                 ImGui::TableSetupColumn("PID");
                 ImGui::TableSetupColumn("Name");
-                ImGui::TableSetupColumn("State");
+                ImGui::TableSetupColumn("RSS");
+                ImGui::TableSetupColumn("PSS");
+                ImGui::TableSetupColumn("USS");
+                ImGui::TableSetupColumn("Shared");
+                ImGui::TableSetupColumn("Swap");
+                ImGui::TableHeadersRow();
+
+                for (const auto &entry : smaps) {
+                    auto row = snap.index.find(entry.first);
+                    if (row == snap.index.end()) continue;
+                    const SmapsRollup &mem = entry.second;
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0); ImGui::Text("%d", entry.first.pid);
+                    ImGui::TableSetColumnIndex(1); ImGui::Text("%s", snap.names.get(snap.table.nameId[row->second]).c_str());
+                    ImGui::TableSetColumnIndex(2); ImGui::Text("%s", formatBytes(mem.rss).c_str());
+                    ImGui::TableSetColumnIndex(3); ImGui::Text("%s", formatBytes(mem.pss).c_str());
+                    ImGui::TableSetColumnIndex(4); ImGui::Text("%s", formatBytes(mem.uss).c_str());
+                    ImGui::TableSetColumnIndex(5); ImGui::Text("%s", formatBytes(mem.shared).c_str());
+                    ImGui::TableSetColumnIndex(6); ImGui::Text("%s", formatBytes(mem.swap).c_str());
+                }
+
+                ImGui::EndTable();
+            }
+            ImGui::EndTabItem();
+        }
+
+        // Consumption per cgroup v2 group, with the snapshot's processes attached
+        if (ImGui::BeginTabItem("Cgroups")) {
+            static unsigned long cgroupGeneration = 0;
+            if (snap.generation != cgroupGeneration) {
+                refreshCgroups(snap);
+                cgroupGeneration = snap.generation;
+            }
+            const CgroupSnapshot &cgroups = getCgroups();
+            if (cgroups.root.empty()) {
+                ImGui::Text("No cgroup v2 hierarchy found under /sys/fs/cgroup");
+            } else if (ImGui::BeginTable("CgroupTable", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                                                           ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY)) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Group");
+                ImGui::TableSetupColumn("Procs");
                 ImGui::TableSetupColumn("CPU %");
-                ImGui::TableSetupColumn("Memory %");
+                ImGui::TableSetupColumn("Memory");
+                ImGui::TableSetupColumn("Anon");
+                ImGui::TableSetupColumn("Read/s");
+                ImGui::TableSetupColumn("Write/s");
+                ImGui::TableSetupColumn("CPU pressure");
                 ImGui::TableHeadersRow();
-                
-                string filterStr = string(filter);
-                transform(filterStr.begin(), filterStr.end(), filterStr.begin(), ::tolower);
-                
-                for (size_t i = 0; i < processes.size(); i++) {
-                    const Proc& proc = processes[i];
-                    
-                    // Apply filter
-                    if (!filterStr.empty()) {
-                        string procName = proc.name;
-                        transform(procName.begin(), procName.end(), procName.begin(), ::tolower);
-                        if (procName.find(filterStr) == string::npos) {
-                            continue;
-                        }
+
+                const float indent = ImGui::GetStyle().IndentSpacing;
+                ImGuiListClipper clipper;
+                clipper.Begin((int)cgroups.order.size());
+                while (clipper.Step()) {
+                    for (int n = clipper.DisplayStart; n < clipper.DisplayEnd; n++) {
+                        const CgroupStats &group = cgroups.groups[cgroups.order[n]];
+                        size_t slash = group.path.rfind('/');
+                        const char *name = group.depth == 0 ? "/" : group.path.c_str() + slash + 1;
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        if (group.depth > 0) ImGui::Indent(group.depth * indent);
+                        ImGui::TextUnformatted(name);
+                        if (group.depth > 0) ImGui::Unindent(group.depth * indent);
+                        ImGui::TableSetColumnIndex(1); ImGui::Text("%d", group.processes);
+                        ImGui::TableSetColumnIndex(2); ImGui::Text("%.1f", group.cpuPercent);
+                        ImGui::TableSetColumnIndex(3); ImGui::Text("%s", formatBytes(group.memoryCurrent).c_str());
+                        ImGui::TableSetColumnIndex(4); ImGui::Text("%s", formatBytes(group.anon).c_str());
+                        ImGui::TableSetColumnIndex(5); ImGui::Text("%s", formatBytes((long long)group.readRate).c_str());
+                        ImGui::TableSetColumnIndex(6); ImGui::Text("%s", formatBytes((long long)group.writeRate).c_str());
+                        ImGui::TableSetColumnIndex(7); ImGui::Text("%.2f%%", group.pressureSome10);
                     }
-                    
+                }
+                ImGui::EndTable();
+            }
+            ImGui::EndTabItem();
+        }
+
+        // CPU history of each selected process since it was selected
+        if (ImGui::BeginTabItem("Selection")) {
+            if (selection.rows.empty()) {
+                ImGui::Text("Click a process (Ctrl+click for several) to follow it here.");
+            }
+            for (const auto &entry : selection.rows) {
+                const vector<float> &samples = selection.history[entry.first];
+                uint32_t row = entry.second;
+                string label = to_string(entry.first.pid) + " " + snap.names.get(snap.table.nameId[row]);
+                char overlay[32];
+                snprintf(overlay, sizeof(overlay), "%.1f%%", snap.table.cpuPercent[row]);
+                ImGui::PlotLines(label.c_str(), samples.data(), (int)samples.size(), 0, overlay, 0.0f, FLT_MAX,
+                                 ImVec2(0, 40));
+            }
+            ImGui::EndTabItem();
+        }
+
+        // Tasks that were born and reaped between samples, from taskstats
+        if (ImGui::BeginTabItem("Recently Exited")) {
+            static bool capture = false;
+            static string captureError;
+            if (ImGui::Checkbox("Capture exiting tasks (taskstats)", &capture)) {
+                if (capture) {
+                    capture = openTaskExits(captureError);
+                } else {
+                    closeTaskExits();
+                }
+            }
+            if (!captureError.empty()) {
+                ImGui::Text("Unavailable: %s", captureError.c_str());
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear")) {
+                clearExitedCommands();
+            }
+            if (getTaskExitOverflows() > 0) {
+                ImGui::Text("Receive buffer overruns: %lld (some exits were missed)", getTaskExitOverflows());
+            }
+
+            vector<const ExitedCommand *> rows;
+            for (const ExitedCommand &cmd : getExitedCommands()) {
+                rows.push_back(&cmd);
+            }
+            sort(rows.begin(), rows.end(), [](const ExitedCommand *a, const ExitedCommand *b) {
+                return a->cpuUsec > b->cpuUsec;
+            });
+
+            if (ImGui::BeginTable("ExitedTable", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {
+                ImGui::TableSetupColumn("Command");
+                ImGui::TableSetupColumn("Tasks");
+                ImGui::TableSetupColumn("CPU (s)");
+                ImGui::TableSetupColumn("Max RSS");
+                ImGui::TableSetupColumn("Read");
+                ImGui::TableSetupColumn("Write");
+                ImGui::TableHeadersRow();
+
+                for (const ExitedCommand *cmd : rows) {
                     ImGui::TableNextRow();
-                    
-                    // Selectable row
-                    ImGui::TableSetColumnIndex(0);
-                    bool isSelected = find(selectedRows.begin(), selectedRows.end(), i) != selectedRows.end();
-                    if (ImGui::Selectable(("##row" + to_string(i)).c_str(), isSelected, ImGuiSelectableFlags_SpanAllColumns)) {
-                        if (ImGui::GetIO().KeyCtrl) {
-                            if (isSelected) {
-                                selectedRows.erase(remove(selectedRows.begin(), selectedRows.end(), i), selectedRows.end());
-                            } else {
-                                selectedRows.push_back(i);
-                            }
-                        } else {
-                            selectedRows.clear();
-                            selectedRows.push_back(i);
-                        }
-                    }
-                    
-                    ImGui::SameLine();
-                    ImGui::Text("%d", proc.pid);
-                    
-                    ImGui::TableSetColumnIndex(1);
-                    ImGui::Text("%s", proc.name.c_str());
-                    
-                    ImGui::TableSetColumnIndex(2);
-                    ImGui::Text("%c", proc.state);
-                    
-                    ImGui::TableSetColumnIndex(3);
-                    ImGui::Text("%.1f", proc.cpu_percent);
-                    
-                    ImGui::TableSetColumnIndex(4);
-                    float memPercent = ram.total > 0 ? (float)(proc.rss * 4096) / ram.total * 100.0f : 0.0f;
-                    ImGui::Text("%.1f", memPercent);
+                    ImGui::TableSetColumnIndex(0); ImGui::Text("%s", cmd->name.c_str());
+                    ImGui::TableSetColumnIndex(1); ImGui::Text("%lld", cmd->tasks);
+                    ImGui::TableSetColumnIndex(2); ImGui::Text("%.2f", cmd->cpuUsec / 1e6);
+                    ImGui::TableSetColumnIndex(3); ImGui::Text("%s", formatBytes(cmd->maxRssKB * 1024).c_str());
+                    ImGui::TableSetColumnIndex(4); ImGui::Text("%s", formatBytes(cmd->readBytes).c_str());
+                    ImGui::TableSetColumnIndex(5); ImGui::Text("%s", formatBytes(cmd->writeBytes).c_str());
                 }
-                
+
                 ImGui::EndTable();
             }
-            
+
             ImGui::EndTabItem();
         }
         ImGui::EndTabBar();
@@ -544,6 +934,20 @@ int main(int, char **)
         ImGui_ImplSDL2_NewFrame(window);
         ImGui::NewFrame();
 
+        // Sample /proc once per tick; every window reads the same snapshot.
+        // A pass cut short by the scan budget carries on the next frame.
+        // Ticks are counted from the start of each pass, so the time a
+        // budgeted pass takes does not stretch the sample interval.
+        static Uint32 lastProcSample = 0;
+        Uint32 now = SDL_GetTicks();
+        bool passOpen = getProcSnapshot().scanProgress < 1.0f;
+        if (lastProcSample == 0 || now - lastProcSample >= (Uint32)procOptions.sampleIntervalMs || passOpen) {
+            if (!passOpen) lastProcSample = now;
+            refreshProcSnapshot();
+        }
+        // Exit records are drained every frame so the socket never overflows
+        pollTaskExits();
+
         {
             ImVec2 mainDisplay = io.DisplaySize;
             memoryProcessesWindow("== Memory and Processes ==",
@@ -29,25 +29,26 @@ Networks getNetworks()
 
 NetStats getNetStats()
 {
+    static ProcFile file("/proc/net/dev");
     NetStats stats;
-    ifstream file("/proc/net/dev");
-    string line;
+    if (!file.read()) return stats;
 
-    getline(file, line);
-    getline(file, line);
+    // Skip the two header lines
+    file.nextLine();
+    file.nextLine();
 
-    while (getline(file, line)) {
-        size_t colon = line.find(':');
-        if (colon != string::npos) {
-            string iface = line.substr(0, colon);
-            iface.erase(0, iface.find_first_not_of(" \t"));
-
-            string data = line.substr(colon + 1);
+    char *line;
+    while ((line = file.nextLine()) != nullptr) {
+        char *colon = strchr(line, ':');
+        if (colon) {
+            char *name = line;
+            while (*name == ' ' || *name == '\t') name++;
+            string iface(name, colon - name);
 
             RX rx = {0};
             TX tx = {0};
 
-            sscanf(data.c_str(), "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+            sscanf(colon + 1, "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
                    &rx.bytes, &rx.packets, &rx.errs, &rx.drop, &rx.fifo, &rx.frame, &rx.compressed, &rx.multicast,
                    &tx.bytes, &tx.packets, &tx.errs, &tx.drop, &tx.fifo, &tx.colls, &tx.carrier, &tx.compressed);
 
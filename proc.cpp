@@ -0,0 +1,955 @@
+#include "header.h"
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// The persistent process table. Windows only ever see it through a const
+// reference, and it is only modified by refreshProcSnapshot() once per
+// sample tick.
+static ProcSnapshot snapshot;
+static bool hasSnapshot = false;
+ProcOptions procOptions = {false, 1000, defaultScanThreads(), false, 50, 8000, false, 60};
+// Generation in which each table row was last seen by a scan, and when
+static vector<unsigned long> rowSeen;
+static vector<double> rowSampled;
+
+// A scan pass reads every pid listed when it started. Under the scan
+// budget a pass can span several refreshes, each resuming at the cursor;
+// exits are only detected once the whole pass is done.
+static vector<int> passPids;
+static size_t passCursor = 0;
+static unsigned long passGeneration = 0;  // snapshot generation the pass started in
+static double passStart = 0;
+static double previousPassStart = 0;
+static unordered_set<int> passAdded;  // pids that got a new row during the pass
+// Field 42 of stat is all zeros unless delay accounting is on; the sysctl
+// is read once per pass
+static bool passBlkio = false;
+
+static uint32_t trigramAt(const string &s, size_t i)
+{
+    return ((uint32_t)(unsigned char)s[i] << 16) | ((uint32_t)(unsigned char)s[i + 1] << 8) |
+           (uint32_t)(unsigned char)s[i + 2];
+}
+
+void NameTable::indexTrigrams(uint32_t id)
+{
+    const string &name = lower[id];
+    indexed[id] = 0;
+    for (size_t i = 0; i + 3 <= name.size(); i++) {
+        uint32_t tri = trigramAt(name, i);
+        // Skip a trigram already seen earlier in this name
+        bool repeated = false;
+        for (size_t j = 0; j < i && !repeated; j++) {
+            repeated = trigramAt(name, j) == tri;
+        }
+        if (repeated) continue;
+        trigrams[tri].push_back(id);
+        indexed[id]++;
+    }
+    liveTrigrams += indexed[id];
+}
+
+uint32_t NameTable::intern(const string &name)
+{
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        refs[it->second]++;
+        return it->second;
+    }
+
+    uint32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        names[id] = name;
+        lower[id] = name;
+        refs[id] = 1;
+    } else {
+        id = names.size();
+        names.push_back(name);
+        lower.push_back(name);
+        refs.push_back(1);
+        indexed.push_back(0);
+    }
+    for (char &c : lower[id]) {
+        c = tolower((unsigned char)c);
+    }
+    ids.emplace(name, id);
+
+    // Rebuild once released names make up most of the index
+    if (staleTrigrams > liveTrigrams) {
+        trigrams.clear();
+        liveTrigrams = staleTrigrams = 0;
+        for (uint32_t other = 0; other < names.size(); other++) {
+            if (refs[other] > 0) indexTrigrams(other);
+        }
+    } else {
+        indexTrigrams(id);
+    }
+    return id;
+}
+
+void NameTable::release(uint32_t id)
+{
+    if (--refs[id] == 0) {
+        ids.erase(names[id]);
+        freeIds.push_back(id);
+        // Repeats within a name were indexed once, so this can be fewer
+        // than the name's length - 2
+        staleTrigrams += indexed[id];
+        liveTrigrams -= indexed[id];
+    }
+}
+
+bool NameTable::matches(uint32_t id, const string &lowerQuery) const
+{
+    return refs[id] > 0 && lower[id].find(lowerQuery) != string::npos;
+}
+
+void NameTable::matchAll(const string &lowerQuery, vector<uint8_t> &result) const
+{
+    result.assign(names.size(), 0);
+
+    if (lowerQuery.size() < 3) {
+        for (uint32_t id = 0; id < names.size(); id++) {
+            result[id] = matches(id, lowerQuery);
+        }
+        return;
+    }
+
+    // Every match contains all of the query's trigrams, so the shortest
+    // posting list bounds the candidates; each one is then verified.
+    const vector<uint32_t> *shortest = nullptr;
+    for (size_t i = 0; i + 3 <= lowerQuery.size(); i++) {
+        auto it = trigrams.find(trigramAt(lowerQuery, i));
+        if (it == trigrams.end()) return;
+        if (!shortest || it->second.size() < shortest->size()) shortest = &it->second;
+    }
+    for (uint32_t id : *shortest) {
+        if (!result[id] && matches(id, lowerQuery)) result[id] = 1;
+    }
+}
+
+uint32_t ProcTable::insert(const Proc &proc, uint32_t name)
+{
+    uint32_t row;
+    if (!freeRows.empty()) {
+        row = freeRows.back();
+        freeRows.pop_back();
+    } else {
+        row = pid.size();
+        pid.emplace_back();
+        starttime.emplace_back();
+        state.emplace_back();
+        ppid.emplace_back();
+        uid.emplace_back();
+        blkioTicks.emplace_back();
+        ioWait.emplace_back();
+        minflt.emplace_back();
+        majflt.emplace_back();
+        ctxtVoluntary.emplace_back();
+        ctxtInvoluntary.emplace_back();
+        minfltRate.emplace_back();
+        majfltRate.emplace_back();
+        ctxtVoluntaryRate.emplace_back();
+        ctxtInvoluntaryRate.emplace_back();
+        utime.emplace_back();
+        stime.emplace_back();
+        vsize.emplace_back();
+        rss.emplace_back();
+        cpuPercent.emplace_back();
+        nameId.emplace_back();
+        alive.emplace_back();
+    }
+    pid[row] = proc.pid;
+    starttime[row] = proc.starttime;
+    nameId[row] = name;
+    alive[row] = 1;
+    set(row, proc);
+    return row;
+}
+
+void ProcTable::set(uint32_t row, const Proc &proc)
+{
+    state[row] = proc.state;
+    ppid[row] = proc.ppid;
+    uid[row] = proc.uid;
+    blkioTicks[row] = proc.blkioTicks;
+    ioWait[row] = proc.io_wait;
+    minflt[row] = proc.minflt;
+    majflt[row] = proc.majflt;
+    ctxtVoluntary[row] = proc.ctxtVoluntary;
+    ctxtInvoluntary[row] = proc.ctxtInvoluntary;
+    minfltRate[row] = proc.minfltRate;
+    majfltRate[row] = proc.majfltRate;
+    ctxtVoluntaryRate[row] = proc.ctxtVoluntaryRate;
+    ctxtInvoluntaryRate[row] = proc.ctxtInvoluntaryRate;
+    utime[row] = proc.utime;
+    stime[row] = proc.stime;
+    vsize[row] = proc.vsize;
+    rss[row] = proc.rss;
+    cpuPercent[row] = proc.cpu_percent;
+}
+
+void ProcTable::erase(uint32_t row)
+{
+    alive[row] = 0;
+    freeRows.push_back(row);
+}
+
+static void countTask(TaskCounts &counts, char state, int delta)
+{
+    counts.total += delta;
+    switch (state) {
+        case 'R': counts.running += delta; break;
+        case 'S': case 'D': case 'I': counts.sleeping += delta; break;
+        case 'T': case 't': counts.stopped += delta; break;
+        case 'Z': counts.zombie += delta; break;
+    }
+}
+
+// Cores that 100% stands for: every online core in Solaris mode, otherwise
+// one. sysconf() costs microseconds, so callers look it up once per
+// refresh rather than per process.
+static int cpuShareCores()
+{
+    return procOptions.solarisMode ? (int)sysconf(_SC_NPROCESSORS_ONLN) : 1;
+}
+
+// Factor from clock ticks to CPU% over [since, now] with 100% standing for
+// `cores` cores; 0 without a previous sample.
+static double cpuScaleSince(double since, double now, int cores)
+{
+    static long clock_ticks = sysconf(_SC_CLK_TCK);
+    if (since <= 0 || now <= since) return 0.0;
+    return 100.0 / (clock_ticks * (now - since) * cores);
+}
+
+// Per-second rate of a counter that went from `before` to `after` over
+// `seconds`; 0 without an interval, and for counters that were not read
+// (-1) at either end
+static float counterRate(long long before, long long after, double seconds)
+{
+    if (seconds <= 0 || before < 0 || after <= before) return 0.0f;
+    return (float)((after - before) / seconds);
+}
+
+// Merge one freshly parsed process, read at `now`, into the table,
+// recording whether it is new or changed since the previous scan. CPU% is
+// the utime+stime delta over the interval since the row's previous sample
+// (0 on the first scan, when there is no interval yet), with 100% standing
+// for `cores` cores.
+static void applyProc(Proc &proc, double now, int cores)
+{
+    ProcTable &table = snapshot.table;
+    ProcKey key = {proc.pid, proc.starttime};
+    auto it = snapshot.index.find(key);
+    if (it == snapshot.index.end()) {
+        // Started after the previous pass listed pids, so all of its CPU
+        // time is in the interval since then
+        double cpuScale = cpuScaleSince(previousPassStart, now, cores);
+        proc.cpu_percent = (float)((proc.utime + proc.stime) * cpuScale);
+        proc.io_wait = (float)(proc.blkioTicks * cpuScale);
+        double seconds = previousPassStart > 0 ? now - previousPassStart : 0;
+        proc.minfltRate = counterRate(0, proc.minflt, seconds);
+        proc.majfltRate = counterRate(0, proc.majflt, seconds);
+        proc.ctxtVoluntaryRate = counterRate(0, proc.ctxtVoluntary, seconds);
+        proc.ctxtInvoluntaryRate = counterRate(0, proc.ctxtInvoluntary, seconds);
+        uint32_t row = table.insert(proc, snapshot.names.intern(proc.name));
+        snapshot.index.emplace(key, row);
+        if (rowSeen.size() < table.size()) {
+            rowSeen.resize(table.size());
+            rowSampled.resize(table.size());
+        }
+        rowSeen[row] = snapshot.generation;
+        rowSampled[row] = now;
+        countTask(snapshot.tasks, proc.state, 1);
+        snapshot.changes.added.push_back({key, row});
+        passAdded.insert(proc.pid);
+        return;
+    }
+
+    uint32_t row = it->second;
+    double cpuScale = cpuScaleSince(rowSampled[row], now, cores);
+    double seconds = rowSampled[row] > 0 ? now - rowSampled[row] : 0;
+    rowSeen[row] = snapshot.generation;
+    rowSampled[row] = now;
+    proc.minfltRate = counterRate(table.minflt[row], proc.minflt, seconds);
+    proc.majfltRate = counterRate(table.majflt[row], proc.majflt, seconds);
+    proc.ctxtVoluntaryRate = counterRate(table.ctxtVoluntary[row], proc.ctxtVoluntary, seconds);
+    proc.ctxtInvoluntaryRate = counterRate(table.ctxtInvoluntary[row], proc.ctxtInvoluntary, seconds);
+    long long ticks = (proc.utime + proc.stime) - (table.utime[row] + table.stime[row]);
+    proc.cpu_percent = ticks > 0 ? (float)(ticks * cpuScale) : 0.0f;
+    long long blkio = proc.blkioTicks - table.blkioTicks[row];
+    proc.io_wait = blkio > 0 ? (float)(blkio * cpuScale) : 0.0f;
+
+    bool changed = table.state[row] != proc.state || table.ppid[row] != proc.ppid || table.uid[row] != proc.uid ||
+                   table.utime[row] != proc.utime || table.stime[row] != proc.stime ||
+                   table.vsize[row] != proc.vsize || table.rss[row] != proc.rss ||
+                   table.cpuPercent[row] != proc.cpu_percent || table.ioWait[row] != proc.io_wait ||
+                   table.blkioTicks[row] != proc.blkioTicks || table.minflt[row] != proc.minflt ||
+                   table.majflt[row] != proc.majflt || table.ctxtVoluntary[row] != proc.ctxtVoluntary ||
+                   table.ctxtInvoluntary[row] != proc.ctxtInvoluntary ||
+                   table.minfltRate[row] != proc.minfltRate || table.majfltRate[row] != proc.majfltRate ||
+                   table.ctxtVoluntaryRate[row] != proc.ctxtVoluntaryRate ||
+                   table.ctxtInvoluntaryRate[row] != proc.ctxtInvoluntaryRate;
+    // exec() and prctl(PR_SET_NAME) rename a process in place
+    if (snapshot.names.get(table.nameId[row]) != proc.name) {
+        snapshot.names.release(table.nameId[row]);
+        table.nameId[row] = snapshot.names.intern(proc.name);
+        changed = true;
+    }
+    if (changed) {
+        if (table.state[row] != proc.state) {
+            countTask(snapshot.tasks, table.state[row], -1);
+            countTask(snapshot.tasks, proc.state, 1);
+        }
+        table.set(row, proc);
+        snapshot.changes.updated.push_back({key, row});
+    }
+}
+
+// Free every row the pass that just finished did not see. Rows never move,
+// so row numbers stay valid handles until their process is removed.
+static void removeExited()
+{
+    ProcTable &table = snapshot.table;
+    for (uint32_t row = 0; row < table.size(); row++) {
+        if (!table.alive[row] || rowSeen[row] >= passGeneration) continue;
+
+        ProcKey key = table.key(row);
+        countTask(snapshot.tasks, table.state[row], -1);
+        snapshot.names.release(table.nameId[row]);
+        snapshot.changes.removed.push_back({key, row});
+        snapshot.index.erase(key);
+        table.erase(row);
+    }
+}
+
+const char *procStatErrorName(ProcStatError err)
+{
+    switch (err) {
+        case PROC_STAT_OK: return "ok";
+        case PROC_STAT_BAD_PID: return "bad pid";
+        case PROC_STAT_NO_COMM: return "missing comm";
+        case PROC_STAT_BAD_STATE: return "bad state";
+        case PROC_STAT_BAD_FIELD: return "bad field";
+        case PROC_STAT_TRUNCATED: return "truncated";
+    }
+    return "unknown";
+}
+
+bool delayAccountingEnabled()
+{
+    int fd = open("/proc/sys/kernel/task_delayacct", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char c = '0';
+    ssize_t n = read(fd, &c, 1);
+    close(fd);
+    return n == 1 && c == '1';
+}
+
+// Parse one space-terminated decimal field starting at *p. Advances *p past
+// the field and its separator.
+static bool parseStatField(const char *&p, const char *end, long long &value)
+{
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    if (p >= end || (unsigned)(*p - '0') > 9) return false;
+
+    unsigned long long v = 0;
+    while (p < end && (unsigned)(*p - '0') <= 9) {
+        v = v * 10 + (unsigned)(*p - '0');
+        p++;
+    }
+    if (p < end) {
+        if (*p != ' ' && *p != '\n') return false;
+        p++;
+    }
+    value = negative ? -(long long)v : (long long)v;
+    return true;
+}
+
+ProcStatError parseProcStat(const char *buf, size_t len, Proc &proc, bool blkio)
+{
+    const char *p = buf;
+    const char *end = buf + len;
+
+    // pid
+    long long pid;
+    if (!parseStatField(p, end, pid) || pid <= 0) return PROC_STAT_BAD_PID;
+    proc.pid = (int)pid;
+
+    // comm is "(...)" and may itself contain spaces and ')', so it ends at
+    // the last ')' on the line.
+    if (p >= end || *p != '(') return PROC_STAT_NO_COMM;
+    const char *name = p + 1;
+    const char *close = (const char *)memrchr(name, ')', end - name);
+    if (!close) return PROC_STAT_NO_COMM;
+    proc.name.assign(name, close - name);
+    p = close + 1;
+
+    // state
+    if (end - p < 3 || p[0] != ' ' || p[2] != ' ') return PROC_STAT_BAD_STATE;
+    proc.state = p[1];
+    p += 3;
+
+    // Fields 4 (ppid) .. 24 (rss); only the ones Proc needs are kept.
+    for (int field = 4; field <= 24; field++) {
+        if (p >= end) return PROC_STAT_TRUNCATED;
+        long long value;
+        if (!parseStatField(p, end, value)) return PROC_STAT_BAD_FIELD;
+        switch (field) {
+            case 4: proc.ppid = (int)value; break;
+            case 10: proc.minflt = value; break;
+            case 12: proc.majflt = value; break;
+            case 14: proc.utime = value; break;
+            case 15: proc.stime = value; break;
+            case 22: proc.starttime = (unsigned long long)value; break;
+            case 23: proc.vsize = value; break;
+            case 24: proc.rss = value; break;
+        }
+    }
+    // Field 42 (delayacct_blkio_ticks) is optional: short lines end earlier.
+    // Fields 25..41 are only stepped over, not parsed.
+    proc.blkioTicks = 0;
+    if (!blkio) return PROC_STAT_OK;
+    int spaces = 42 - 25;
+    while (p < end && spaces > 0) {
+        spaces -= *p++ == ' ';
+    }
+    if (spaces > 0) return PROC_STAT_OK;
+    if (p < end && !parseStatField(p, end, proc.blkioTicks)) return PROC_STAT_BAD_FIELD;
+    return PROC_STAT_OK;
+}
+
+int procDirFd()
+{
+    static int fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return fd;
+}
+
+int openPidFile(int dirfd, int pid, const char *file, int flags)
+{
+    // "<pid>/<file>" relative to dirfd, formatted by hand
+    char path[64];
+    char digits[16];
+    int n = 0;
+    unsigned int value = (unsigned int)pid;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    size_t len = strlen(file);
+    if (n + 1 + len >= sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    char *p = path;
+    while (n > 0) *p++ = digits[--n];
+    *p++ = '/';
+    memcpy(p, file, len + 1);
+    return openat(dirfd, path, O_RDONLY | O_CLOEXEC | flags);
+}
+
+// Directory fd for a scan root: the cached /proc fd, or a directory opened
+// for the lifetime of this object (task directories, test trees).
+class RootDir
+{
+public:
+    explicit RootDir(const char *root) : owned(strcmp(root, "/proc") != 0)
+    {
+        fd = owned ? open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : procDirFd();
+    }
+    RootDir(int dirfd, int pid, const char *dir) : fd(openPidFile(dirfd, pid, dir, O_DIRECTORY)), owned(true) {}
+    ~RootDir()
+    {
+        if (owned && fd >= 0) close(fd);
+    }
+    RootDir(const RootDir &) = delete;
+    RootDir &operator=(const RootDir &) = delete;
+
+    int fd;
+
+private:
+    bool owned;
+};
+
+// Read <dirfd>/<pid>/<file> into buf without going through a stream.
+// Returns the number of bytes read, or -1 with errno set if the process has
+// gone away or the file is not readable. The files of /proc/[pid] belong
+// to the process's effective uid, which is stored in `owner` if given.
+static ssize_t readPidFile(int dirfd, int pid, const char *file, char *buf, size_t cap, uid_t *owner = nullptr)
+{
+    int fd = openPidFile(dirfd, pid, file);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (owner) *owner = fstat(fd, &st) == 0 ? st.st_uid : (uid_t)-1;
+    ssize_t n = read(fd, buf, cap);
+    int err = errno;
+    close(fd);
+    errno = err;
+    return n;
+}
+
+// Record layout of getdents64(2), which glibc only wraps since 2.30
+struct LinuxDirent64 {
+    uint64_t ino;
+    int64_t off;
+    unsigned short reclen;
+    unsigned char type;
+    char name[];
+};
+
+// Names that are all digits, e.g. "4242"; "self", "sys" etc. are skipped
+static bool parsePidName(const char *name, int &pid)
+{
+    unsigned int value = 0;
+    int digits = 0;
+    for (; *name; name++, digits++) {
+        unsigned int d = (unsigned char)*name - '0';
+        if (d > 9 || digits == 9) return false;
+        value = value * 10 + d;
+    }
+    pid = (int)value;
+    return digits > 0;
+}
+
+static void listPidsAt(int dirfd, vector<int> &pids)
+{
+    pids.clear();
+    if (dirfd < 0 || lseek(dirfd, 0, SEEK_SET) < 0) return;
+
+    // One getdents64 call returns thousands of entries, so a full /proc
+    // listing is a handful of syscalls
+    static thread_local vector<char> buf(256 * 1024);
+    while (true) {
+        long n = syscall(SYS_getdents64, dirfd, buf.data(), buf.size());
+        if (n <= 0) break;
+        for (long offset = 0; offset < n;) {
+            const LinuxDirent64 *entry = (const LinuxDirent64 *)(buf.data() + offset);
+            int pid;
+            if (parsePidName(entry->name, pid)) pids.push_back(pid);
+            offset += entry->reclen;
+        }
+    }
+}
+
+void listPids(const char *root, vector<int> &pids)
+{
+    RootDir dir(root);
+    listPidsAt(dir.fd, pids);
+}
+
+// Fixed pool of scan workers. run() hands the same job to every worker
+// plus the calling thread and returns once all of them have finished;
+// the job itself pulls work from a shared counter.
+class ScanPool
+{
+public:
+    ~ScanPool() { resize(0); }
+
+    void resize(int threads)
+    {
+        if ((int)workers.size() == threads) return;
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread &t : workers) t.join();
+        workers.clear();
+        stopping = false;
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([this, i, seen = round] { workerLoop(i + 1, seen); });
+        }
+    }
+
+    void run(const function<void(int)> &fn)
+    {
+        {
+            lock_guard<mutex> lock(m);
+            job = &fn;
+            pending = workers.size();
+            round++;
+        }
+        wake.notify_all();
+        fn(0);
+        unique_lock<mutex> lock(m);
+        done.wait(lock, [this] { return pending == 0; });
+        job = nullptr;
+    }
+
+private:
+    void workerLoop(int worker, unsigned long seen)
+    {
+        while (true) {
+            const function<void(int)> *fn;
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait(lock, [&] { return stopping || round != seen; });
+                if (stopping) return;
+                seen = round;
+                fn = job;
+            }
+            (*fn)(worker);
+            lock_guard<mutex> lock(m);
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    vector<thread> workers;
+    mutex m;
+    condition_variable wake, done;
+    const function<void(int)> *job = nullptr;
+    size_t pending = 0;
+    unsigned long round = 0;
+    bool stopping = false;
+};
+
+int defaultScanThreads()
+{
+    int cores = (int)thread::hardware_concurrency();
+    return cores < 1 ? 1 : (cores > 8 ? 8 : cores);
+}
+
+size_t scanProcStats(const char *root, const vector<int> &pids, int threads, vector<Proc> &out, size_t begin,
+                     double deadline, vector<int> *gone, bool blkio)
+{
+    static ScanPool pool;
+    // One output buffer per worker; Procs are kept across scans so their
+    // name strings keep their capacity.
+    static vector<vector<Proc>> workerProcs;
+    static vector<size_t> workerCount;
+    static vector<vector<int>> workerGone;
+
+    if (threads < 1) threads = 1;
+
+    // The pool is only resized when the thread count setting changes, never
+    // with the number of pids: a worker that finds nothing left to claim
+    // simply returns
+    pool.resize(threads - 1);
+    if (workerProcs.size() < (size_t)threads) {
+        workerProcs.resize(threads);
+        workerCount.resize(threads);
+        workerGone.resize(threads);
+    }
+
+    // Every claimed batch is read to the end, so the pids read always form
+    // the prefix [begin, next). With a deadline, batches are kept small so
+    // a worker notices it soon after it passes. Otherwise a batch is a few
+    // hundred pids, below which splitting the work costs more than it saves.
+    const size_t batch = deadline > 0 ? 16 : 256;
+    atomic<size_t> next(begin);
+    atomic<bool> expired(false);
+    RootDir dir(root);
+    // The status file costs a second open and read per pid, so it is only
+    // read while a column shows its counters
+    bool readStatus = procOptions.readStatus;
+    pool.run([&](int worker) {
+        vector<Proc> &procs = workerProcs[worker];
+        workerGone[worker].clear();
+        size_t count = 0;
+        char buf[4096];
+        size_t first;
+        while (!expired && (first = next.fetch_add(batch)) < pids.size()) {
+            size_t end = min(first + batch, pids.size());
+            for (size_t i = first; i < end; i++) {
+                uid_t owner;
+                ssize_t n = readPidFile(dir.fd, pids[i], "stat", buf, sizeof(buf), &owner);
+                if (n < 0 && (errno == ENOENT || errno == ESRCH)) workerGone[worker].push_back(pids[i]);
+                if (n <= 0) continue;
+                if (count == procs.size()) procs.emplace_back();
+                Proc &proc = procs[count];
+                if (parseProcStat(buf, n, proc, blkio) != PROC_STAT_OK) continue;
+                proc.uid = owner;
+                proc.ctxtVoluntary = proc.ctxtInvoluntary = -1;
+                if (readStatus) {
+                    n = readPidFile(dir.fd, pids[i], "status", buf, sizeof(buf));
+                    if (n <= 0 || !parseProcStatusCtxt(buf, n, proc.ctxtVoluntary, proc.ctxtInvoluntary)) {
+                        proc.ctxtVoluntary = proc.ctxtInvoluntary = -1;
+                    }
+                }
+                count++;
+            }
+            if (deadline > 0 && monotonicSeconds() >= deadline) expired = true;
+        }
+        workerCount[worker] = count;
+    });
+
+    out.clear();
+    for (int w = 0; w < threads; w++) {
+        out.insert(out.end(), workerProcs[w].begin(), workerProcs[w].begin() + workerCount[w]);
+        if (gone) gone->insert(gone->end(), workerGone[w].begin(), workerGone[w].end());
+    }
+    return min(next.load(), pids.size());
+}
+
+bool refreshThreadList(ThreadList &list, const char *root)
+{
+    RootDir dir(root);
+    RootDir taskDir(dir.fd, list.key.pid, "task");
+    static vector<int> tids;
+    listPidsAt(taskDir.fd, tids);
+
+    double timestamp = monotonicSeconds();
+    double cpuScale = cpuScaleSince(list.timestamp, timestamp, cpuShareCores());
+    list.timestamp = timestamp;
+
+    // Refill in place so the name strings keep their capacity
+    unordered_map<ProcKey, long long, ProcKeyHash> previous;
+    previous.swap(list.ticks);
+    size_t count = 0;
+    bool sameProcess = false;
+    char buf[1024];
+    for (int tid : tids) {
+        ssize_t n = readPidFile(taskDir.fd, tid, "stat", buf, sizeof(buf));
+        if (n <= 0) continue;
+        if (count == list.threads.size()) list.threads.emplace_back();
+        Proc &thread = list.threads[count];
+        if (parseProcStat(buf, n, thread) != PROC_STAT_OK) continue;
+        // The main thread shares the process's identity; anything else
+        // means the pid now belongs to a different process.
+        if (thread.pid == list.key.pid) {
+            if (thread.starttime != list.key.starttime) break;
+            sameProcess = true;
+        }
+
+        ProcKey key = {thread.pid, thread.starttime};
+        long long ticks = thread.utime + thread.stime;
+        auto it = previous.find(key);
+        // A thread that started since the last read used all its time in the interval
+        long long delta = ticks - (it != previous.end() ? it->second : 0);
+        thread.cpu_percent = delta > 0 ? (float)(delta * cpuScale) : 0.0f;
+        list.ticks.emplace(key, ticks);
+        count++;
+    }
+    list.threads.resize(sameProcess ? count : 0);
+    return sameProcess;
+}
+
+bool parseProcIo(const char *buf, size_t len, ProcIoCounters &io)
+{
+    static const struct {
+        const char *key;
+        long long ProcIoCounters::*field;
+    } fields[] = {
+        {"rchar", &ProcIoCounters::rchar},
+        {"wchar", &ProcIoCounters::wchar},
+        {"syscr", &ProcIoCounters::syscr},
+        {"syscw", &ProcIoCounters::syscw},
+        {"read_bytes", &ProcIoCounters::readBytes},
+        {"write_bytes", &ProcIoCounters::writeBytes},
+        {"cancelled_write_bytes", &ProcIoCounters::cancelledWriteBytes},
+    };
+    const char *p = buf;
+    const char *end = buf + len;
+    unsigned found = 0;
+    while (p < end) {
+        const char *colon = (const char *)memchr(p, ':', end - p);
+        if (!colon) break;
+        const char *value = colon + 1;
+        while (value < end && *value == ' ') value++;
+        for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+            if (strlen(fields[f].key) == (size_t)(colon - p) && memcmp(fields[f].key, p, colon - p) == 0) {
+                long long v;
+                if (parseStatField(value, end, v)) {
+                    io.*fields[f].field = v;
+                    found |= 1u << f;
+                }
+                break;
+            }
+        }
+        const char *newline = (const char *)memchr(colon, '\n', end - colon);
+        p = newline ? newline + 1 : end;
+    }
+    // syscr, syscw, read_bytes and write_bytes
+    return (found & 0x3c) == 0x3c;
+}
+
+bool parseProcStatusCtxt(const char *buf, size_t len, long long &voluntary, long long &involuntary)
+{
+    static const char voluntaryKey[] = "voluntary_ctxt_switches:";
+    static const char involuntaryKey[] = "nonvoluntary_ctxt_switches:";
+    const char *p = buf;
+    const char *end = buf + len;
+    unsigned found = 0;
+    while (p < end) {
+        const char *newline = (const char *)memchr(p, '\n', end - p);
+        const char *lineEnd = newline ? newline : end;
+        const char *value = nullptr;
+        long long *target = nullptr;
+        unsigned bit = 0;
+        if ((size_t)(lineEnd - p) > sizeof(voluntaryKey) - 1 &&
+            memcmp(p, voluntaryKey, sizeof(voluntaryKey) - 1) == 0) {
+            value = p + sizeof(voluntaryKey) - 1;
+            target = &voluntary;
+            bit = 1;
+        } else if ((size_t)(lineEnd - p) > sizeof(involuntaryKey) - 1 &&
+                   memcmp(p, involuntaryKey, sizeof(involuntaryKey) - 1) == 0) {
+            value = p + sizeof(involuntaryKey) - 1;
+            target = &involuntary;
+            bit = 2;
+        }
+        if (target) {
+            // Values are tab-aligned
+            while (value < lineEnd && (*value == '\t' || *value == ' ')) value++;
+            long long v;
+            if (parseStatField(value, end, v) && v >= 0) {
+                *target = v;
+                found |= bit;
+            }
+        }
+        p = newline ? newline + 1 : end;
+    }
+    return found == 3;
+}
+
+ProcIoStatus readProcIo(const char *root, int pid, ProcIoCounters &io)
+{
+    char buf[512];
+    RootDir dir(root);
+    ssize_t n = readPidFile(dir.fd, pid, "io", buf, sizeof(buf));
+    if (n < 0) return errno == EACCES || errno == EPERM ? PROC_IO_DENIED : PROC_IO_GONE;
+    return parseProcIo(buf, n, io) ? PROC_IO_OK : PROC_IO_GONE;
+}
+
+// Process tracking: either list /proc on every tick, or keep the pid set
+// up to date from proc connector events and only re-read live pids.
+static ProcTrackMode trackMode = PROC_TRACK_SCAN;
+static string trackError;
+static bool trackAttempted = false;
+static unordered_set<int> livePids;
+// Full rescans in netlink mode, as a safety net against missed events
+static const unsigned long resyncEvery = 60;
+
+static void collectPids(vector<int> &pids)
+{
+    if (procOptions.useProcEvents && !trackAttempted) {
+        // Subscribe before the seeding scan below so no fork falls in between
+        trackAttempted = true;
+        if (openProcEvents(trackError)) {
+            trackMode = PROC_TRACK_NETLINK;
+            livePids.clear();
+        }
+    } else if (!procOptions.useProcEvents && trackAttempted) {
+        closeProcEvents();
+        trackAttempted = false;
+        trackMode = PROC_TRACK_SCAN;
+        trackError.clear();
+    }
+
+    if (trackMode == PROC_TRACK_SCAN) {
+        listPids("/proc", pids);
+        return;
+    }
+
+    bool inSync = readProcEvents(livePids);
+    if (!inSync || livePids.empty() || snapshot.passes % resyncEvery == 0) {
+        listPids("/proc", pids);
+        livePids.clear();
+        livePids.insert(pids.begin(), pids.end());
+        return;
+    }
+    pids.assign(livePids.begin(), livePids.end());
+}
+
+// Forget pids whose row went away this pass, unless the pid was reused by
+// a process that was added during it. Pids that never got a row (a fork
+// and exit between two reads) are dropped as the scan finds them gone.
+static void pruneLivePids()
+{
+    for (const ProcChange &gone : snapshot.changes.removed) {
+        if (!passAdded.count(gone.key.pid)) {
+            livePids.erase(gone.key.pid);
+        }
+    }
+}
+
+ProcTrackMode getProcTrackMode()
+{
+    return trackMode;
+}
+
+const string &getProcTrackError()
+{
+    return trackError;
+}
+
+void refreshProcSnapshot()
+{
+    snapshot.generation++;
+    snapshot.changes.added.clear();
+    snapshot.changes.removed.clear();
+    snapshot.changes.updated.clear();
+    hasSnapshot = true;
+
+    // CPU% is measured over the interval since each row's previous sample
+    // on the monotonic clock, like top, rather than averaged over process
+    // lifetime.
+    double timestamp = monotonicSeconds();
+    snapshot.timestamp = timestamp;
+
+    if (passCursor == passPids.size()) {
+        collectPids(passPids);
+        passCursor = 0;
+        passGeneration = snapshot.generation;
+        previousPassStart = passStart;
+        passStart = timestamp;
+        passAdded.clear();
+        passBlkio = delayAccountingEnabled();
+    }
+
+    // Parse in parallel up to the budget, then merge into the table on
+    // this thread
+    static vector<Proc> scanned;
+    static vector<int> gone;
+    gone.clear();
+    double deadline = procOptions.scanBudgetUs > 0 ? timestamp + procOptions.scanBudgetUs / 1e6 : 0;
+    passCursor = scanProcStats("/proc", passPids, procOptions.scanThreads, scanned, passCursor, deadline, &gone,
+                               passBlkio);
+    if (trackMode == PROC_TRACK_NETLINK) {
+        for (int pid : gone) {
+            livePids.erase(pid);
+        }
+    }
+    int cores = cpuShareCores();
+    for (Proc &proc : scanned) {
+        applyProc(proc, timestamp, cores);
+    }
+
+    if (passCursor == passPids.size()) {
+        removeExited();
+        if (trackMode == PROC_TRACK_NETLINK) {
+            pruneLivePids();
+        }
+        snapshot.passes++;
+        snapshot.scanProgress = 1.0f;
+        snapshot.completedAt = passStart;
+    } else {
+        snapshot.scanProgress = (float)passCursor / passPids.size();
+    }
+}
+
+const ProcSnapshot &getProcSnapshot()
+{
+    // Callers outside the UI loop (e.g. the function tests) never tick,
+    // so take a first sample on demand.
+    if (!hasSnapshot) {
+        refreshProcSnapshot();
+    }
+    return snapshot;
+}
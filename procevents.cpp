@@ -0,0 +1,109 @@
+#include "header.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+// Netlink socket subscribed to the kernel proc connector, or -1
+static int sock = -1;
+
+bool openProcEvents(string &error)
+{
+    closeProcEvents();
+
+    sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (sock < 0) {
+        error = string("socket: ") + strerror(errno);
+        return false;
+    }
+
+    struct sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        // Joining the connector group needs CAP_NET_ADMIN
+        error = string("bind: ") + strerror(errno);
+        closeProcEvents();
+        return false;
+    }
+
+    // Large receive buffer so a fork storm between ticks does not overflow
+    int rcvbuf = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    alignas(struct nlmsghdr) char req[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] = {};
+    struct nlmsghdr *hdr = (struct nlmsghdr *)req;
+    hdr->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+    hdr->nlmsg_type = NLMSG_DONE;
+    struct cn_msg *msg = (struct cn_msg *)NLMSG_DATA(hdr);
+    msg->id.idx = CN_IDX_PROC;
+    msg->id.val = CN_VAL_PROC;
+    msg->len = sizeof(enum proc_cn_mcast_op);
+    enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    memcpy(msg->data, &op, sizeof(op));
+    if (send(sock, req, hdr->nlmsg_len, 0) < 0) {
+        error = string("subscribe: ") + strerror(errno);
+        closeProcEvents();
+        return false;
+    }
+
+    error.clear();
+    return true;
+}
+
+void closeProcEvents()
+{
+    if (sock >= 0) {
+        close(sock);
+        sock = -1;
+    }
+}
+
+bool readProcEvents(unordered_set<int> &live)
+{
+    if (sock < 0) return false;
+
+    alignas(struct nlmsghdr) char buf[16384];
+    while (true) {
+        ssize_t n = recv(sock, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            if (errno == EINTR) continue;
+            // ENOBUFS: events were dropped, the caller has to rescan
+            return false;
+        }
+
+        for (struct nlmsghdr *hdr = (struct nlmsghdr *)buf; NLMSG_OK(hdr, (size_t)n); hdr = NLMSG_NEXT(hdr, n)) {
+            if (hdr->nlmsg_type == NLMSG_ERROR || hdr->nlmsg_type == NLMSG_OVERRUN) return false;
+            if (hdr->nlmsg_type != NLMSG_DONE) continue;
+
+            struct cn_msg *msg = (struct cn_msg *)NLMSG_DATA(hdr);
+            if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC) continue;
+            struct proc_event *ev = (struct proc_event *)msg->data;
+
+            // Threads share their leader's tgid; only whole processes are tracked
+            switch (ev->what) {
+                case proc_event::PROC_EVENT_FORK:
+                    if (ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid) {
+                        live.insert(ev->event_data.fork.child_tgid);
+                    }
+                    break;
+                case proc_event::PROC_EVENT_EXEC:
+                    live.insert(ev->event_data.exec.process_tgid);
+                    break;
+                case proc_event::PROC_EVENT_COMM:
+                    live.insert(ev->event_data.comm.process_tgid);
+                    break;
+                case proc_event::PROC_EVENT_EXIT:
+                    // The task stays in /proc as a zombie until it is reaped, so
+                    // the pid is only dropped once the scan finds its /proc
+                    // directory gone.
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#include "header.h"
+#include <fcntl.h>
+#include <cstring>
+
+ProcFile::ProcFile(const char *path)
+    : fd(open(path, O_RDONLY | O_CLOEXEC)), buffer(4096), length(0), cursor(0)
+{
+}
+
+ProcFile::~ProcFile()
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool ProcFile::read()
+{
+    length = 0;
+    cursor = 0;
+    if (fd < 0) return false;
+
+    // /proc files report a size of 0, so grow the buffer until one pread
+    // returns less than it could hold (one byte is kept for the NUL).
+    while (true) {
+        ssize_t n = pread(fd, buffer.data(), buffer.size() - 1, 0);
+        if (n < 0) {
+            return false;
+        }
+        if ((size_t)n < buffer.size() - 1) {
+            length = (size_t)n;
+            buffer[length] = '\0';
+            return true;
+        }
+        buffer.resize(buffer.size() * 2);
+    }
+}
+
+char *ProcFile::nextLine()
+{
+    if (cursor >= length) return nullptr;
+
+    char *line = buffer.data() + cursor;
+    char *end = (char *)memchr(line, '\n', length - cursor);
+    if (end) {
+        *end = '\0';
+        cursor = (end - buffer.data()) + 1;
+    } else {
+        cursor = length;
+    }
+    return line;
+}
@@ -0,0 +1,560 @@
+#include "header.h"
+#include <algorithm>
+#include <cctype>
+#include <functional>
+
+namespace {
+
+// Strict ordering of table rows by a list of sort keys, ties broken by pid
+struct RowLess {
+    const ProcSnapshot &snap;
+    const vector<ProcSortKey> &keys;
+
+    int compare(const ProcSortKey &key, uint32_t a, uint32_t b) const
+    {
+        const ProcTable &t = snap.table;
+        switch (key.column) {
+            case PROC_SORT_PID:
+                return t.pid[a] < t.pid[b] ? -1 : t.pid[a] > t.pid[b];
+            case PROC_SORT_NAME:
+                if (t.nameId[a] == t.nameId[b]) return 0;
+                return snap.names.get(t.nameId[a]).compare(snap.names.get(t.nameId[b]));
+            case PROC_SORT_USER:
+                return t.uid[a] < t.uid[b] ? -1 : t.uid[a] > t.uid[b];
+            case PROC_SORT_STATE:
+                return t.state[a] < t.state[b] ? -1 : t.state[a] > t.state[b];
+            case PROC_SORT_CPU:
+                return t.cpuPercent[a] < t.cpuPercent[b] ? -1 : t.cpuPercent[a] > t.cpuPercent[b];
+            case PROC_SORT_MEMORY:
+                return t.rss[a] < t.rss[b] ? -1 : t.rss[a] > t.rss[b];
+            case PROC_SORT_MINFLT:
+                return t.minfltRate[a] < t.minfltRate[b] ? -1 : t.minfltRate[a] > t.minfltRate[b];
+            case PROC_SORT_MAJFLT:
+                return t.majfltRate[a] < t.majfltRate[b] ? -1 : t.majfltRate[a] > t.majfltRate[b];
+            case PROC_SORT_CTXT_VOLUNTARY: {
+                const vector<float> &rate = t.ctxtVoluntaryRate;
+                return rate[a] < rate[b] ? -1 : rate[a] > rate[b];
+            }
+            case PROC_SORT_CTXT_INVOLUNTARY: {
+                const vector<float> &rate = t.ctxtInvoluntaryRate;
+                return rate[a] < rate[b] ? -1 : rate[a] > rate[b];
+            }
+        }
+        return 0;
+    }
+
+    bool operator()(uint32_t a, uint32_t b) const
+    {
+        for (const ProcSortKey &key : keys) {
+            int c = compare(key, a, b);
+            if (c != 0) return key.descending ? c > 0 : c < 0;
+        }
+        return snap.table.pid[a] < snap.table.pid[b];
+    }
+};
+
+}
+
+bool updateProcOrder(ProcOrder &order, const ProcSnapshot &snap, const vector<ProcSortKey> &keys)
+{
+    const ProcTable &table = snap.table;
+    RowLess less = {snap, keys};
+
+    bool sameKeys = keys == order.keys;
+    if (sameKeys && order.generation == snap.generation) return false;
+
+    // New sort keys, first use, or a missed refresh: sort from scratch
+    if (!sameKeys || order.generation == 0 || snap.generation != order.generation + 1) {
+        order.rows.clear();
+        for (uint32_t row = 0; row < table.size(); row++) {
+            if (table.alive[row]) order.rows.push_back(row);
+        }
+        sort(order.rows.begin(), order.rows.end(), less);
+        order.keys = keys;
+        order.generation = snap.generation;
+        order.version++;
+        return true;
+    }
+
+    // Rows whose values did not change keep their relative order, so take
+    // the changed and new rows out, sort just those, and merge them back:
+    // O(n + k log k) for k changed rows instead of O(n log n).
+    const ProcChanges &changes = snap.changes;
+    order.dirty.resize(table.size(), 0);
+    for (const ProcChange &change : changes.removed) order.dirty[change.row] = 1;
+    for (const ProcChange &change : changes.updated) order.dirty[change.row] = 1;
+
+    size_t kept = 0;
+    for (uint32_t row : order.rows) {
+        if (!order.dirty[row]) order.rows[kept++] = row;
+    }
+    order.rows.resize(kept);
+
+    order.moved.clear();
+    for (const ProcChange &change : changes.updated) order.moved.push_back(change.row);
+    for (const ProcChange &change : changes.added) order.moved.push_back(change.row);
+    sort(order.moved.begin(), order.moved.end(), less);
+
+    order.merged.resize(order.rows.size() + order.moved.size());
+    merge(order.rows.begin(), order.rows.end(), order.moved.begin(), order.moved.end(), order.merged.begin(), less);
+    order.rows.swap(order.merged);
+
+    for (const ProcChange &change : changes.removed) order.dirty[change.row] = 0;
+    for (const ProcChange &change : changes.updated) order.dirty[change.row] = 0;
+    order.generation = snap.generation;
+    order.version++;
+    return false;
+}
+
+const vector<uint32_t> &updateProcFilter(ProcFilter &filter, const ProcSnapshot &snap, const ProcOrder &order,
+                                         const char *text)
+{
+    const ProcTable &table = snap.table;
+
+    string query = text;
+    for (char &c : query) {
+        c = tolower((unsigned char)c);
+    }
+    if (query.empty()) {
+        filter.query.clear();
+        return order.rows;
+    }
+
+    bool rematch = false;
+    if (query != filter.query || filter.generation == 0 || snap.generation > filter.generation + 1) {
+        // New text, or a missed refresh: match every name through the index
+        filter.query = query;
+        snap.names.matchAll(filter.query, filter.nameMatches);
+        rematch = true;
+    } else if (snap.generation != filter.generation) {
+        // Only names that were just added or renamed need matching
+        filter.nameMatches.resize(snap.names.names.size(), 0);
+        for (const vector<ProcChange> *changes : {&snap.changes.added, &snap.changes.updated}) {
+            for (const ProcChange &change : *changes) {
+                uint32_t id = table.nameId[change.row];
+                filter.nameMatches[id] = snap.names.matches(id, filter.query);
+            }
+        }
+        rematch = true;
+    }
+    filter.generation = snap.generation;
+
+    if (rematch || filter.orderVersion != order.version) {
+        filter.rows.clear();
+        for (uint32_t row : order.rows) {
+            if (filter.nameMatches[table.nameId[row]]) filter.rows.push_back(row);
+        }
+        filter.orderVersion = order.version;
+    }
+    return filter.rows;
+}
+
+void selectProc(ProcSelection &sel, const ProcSnapshot &snap, uint32_t row, bool additive)
+{
+    ProcKey key = snap.table.key(row);
+    sel.dirty = true;
+    if (!additive) {
+        sel.rows.clear();
+    } else if (sel.rows.erase(key)) {
+        return;
+    }
+    sel.rows[key] = row;
+}
+
+void updateProcSelection(ProcSelection &sel, const ProcSnapshot &snap)
+{
+    bool refreshed = snap.generation != sel.generation;
+    if (refreshed) {
+        if (snap.generation > sel.generation + 1) {
+            // Missed a refresh: look every selected process up again
+            for (auto it = sel.rows.begin(); it != sel.rows.end();) {
+                auto found = snap.index.find(it->first);
+                if (found == snap.index.end()) {
+                    it = sel.rows.erase(it);
+                } else {
+                    it->second = found->second;
+                    ++it;
+                }
+            }
+        } else {
+            for (const ProcChange &change : snap.changes.removed) {
+                sel.rows.erase(change.key);
+            }
+        }
+        sel.generation = snap.generation;
+    }
+    // One history sample per complete pass, not per partial refresh
+    bool sampled = snap.passes != sel.passes;
+    sel.passes = snap.passes;
+    if (!refreshed && !sel.dirty) return;
+
+    const ProcTable &table = snap.table;
+    sel.cpuPercent = 0;
+    sel.rss = 0;
+    for (const auto &entry : sel.rows) {
+        uint32_t row = entry.second;
+        sel.cpuPercent += table.cpuPercent[row];
+        sel.rss += table.rss[row];
+        if (sampled) {
+            vector<float> &samples = sel.history[entry.first];
+            if (samples.size() == ProcSelection::historyLength) {
+                samples.erase(samples.begin());
+            }
+            samples.push_back(table.cpuPercent[row]);
+        }
+    }
+    // History goes with the selection
+    if (sel.history.size() > sel.rows.size()) {
+        for (auto it = sel.history.begin(); it != sel.history.end();) {
+            it = sel.contains(it->first) ? next(it) : sel.history.erase(it);
+        }
+    }
+    sel.dirty = false;
+}
+
+void smapsTargets(const ProcSnapshot &snap, const ProcSelection &sel, size_t topN, vector<ProcKey> &keys)
+{
+    keys.clear();
+    for (const auto &entry : sel.rows) {
+        keys.push_back(entry.first);
+    }
+    if (topN == 0) return;
+
+    const ProcTable &table = snap.table;
+    vector<uint32_t> rows;
+    rows.reserve(table.count());
+    for (uint32_t row = 0; row < table.size(); row++) {
+        if (table.alive[row]) rows.push_back(row);
+    }
+    topN = min(topN, rows.size());
+    auto larger = [&](uint32_t a, uint32_t b) { return table.rss[a] > table.rss[b]; };
+    nth_element(rows.begin(), rows.begin() + topN, rows.end(), larger);
+    for (size_t i = 0; i < topN; i++) {
+        if (!sel.contains(table.key(rows[i]))) keys.push_back(table.key(rows[i]));
+    }
+}
+
+void updateProcTopN(ProcTopN &top, const ProcSnapshot &snap)
+{
+    if (top.generation == snap.generation && snap.generation != 0) return;
+    top.generation = snap.generation;
+
+    // Min-heaps of (value, row): the root is the smallest value still in
+    // the top n, so most rows are rejected with a single comparison
+    typedef pair<double, uint32_t> Entry;
+    vector<Entry> heaps[PROC_TOP_METRICS];
+    for (vector<Entry> &heap : heaps) {
+        heap.reserve(top.n + 1);
+    }
+    auto offer = [&](vector<Entry> &heap, double value, uint32_t row) {
+        if (value <= 0) return;
+        if (heap.size() == top.n) {
+            if (Entry(value, row) <= heap.front()) return;
+            pop_heap(heap.begin(), heap.end(), greater<Entry>());
+            heap.pop_back();
+        }
+        heap.emplace_back(value, row);
+        push_heap(heap.begin(), heap.end(), greater<Entry>());
+    };
+
+    const ProcTable &table = snap.table;
+    if (top.n > 0) {
+        for (uint32_t row = 0; row < table.size(); row++) {
+            if (!table.alive[row]) continue;
+            offer(heaps[PROC_TOP_CPU], table.cpuPercent[row], row);
+            offer(heaps[PROC_TOP_RSS], (double)table.rss[row], row);
+            offer(heaps[PROC_TOP_IO_WAIT], table.ioWait[row], row);
+        }
+    }
+    for (int metric = 0; metric < PROC_TOP_METRICS; metric++) {
+        // Sorting a min-heap with greater<> leaves it in descending order
+        vector<Entry> &heap = heaps[metric];
+        sort_heap(heap.begin(), heap.end(), greater<Entry>());
+        top.rows[metric].clear();
+        for (const Entry &entry : heap) {
+            top.rows[metric].push_back(entry.second);
+        }
+    }
+}
+
+namespace {
+
+// Add (cpu, rss) to the subtree totals of `row`'s ancestors
+void addToAncestors(ProcTree &tree, uint32_t row, double cpu, long long rss)
+{
+    for (uint32_t p = tree.parent[row]; p != ProcTree::none; p = tree.parent[p]) {
+        tree.subtreeCpu[p] += cpu;
+        tree.subtreeRss[p] += rss;
+    }
+}
+
+// Swap-remove `row` from `list` (its parent's children, or the roots): a
+// reaper can have thousands of children
+void unlink(ProcTree &tree, vector<uint32_t> &list, uint32_t row)
+{
+    uint32_t last = list.back();
+    list[tree.slot[row]] = last;
+    tree.slot[last] = tree.slot[row];
+    list.pop_back();
+}
+
+void addRoot(ProcTree &tree, uint32_t row)
+{
+    tree.parent[row] = ProcTree::none;
+    tree.slot[row] = (uint32_t)tree.roots.size();
+    tree.roots.push_back(row);
+}
+
+// Make `row` a root, taking its subtree off its ancestors' totals
+void detach(ProcTree &tree, uint32_t row)
+{
+    uint32_t p = tree.parent[row];
+    if (p == ProcTree::none) return;
+    addToAncestors(tree, row, -tree.subtreeCpu[row], -tree.subtreeRss[row]);
+    unlink(tree, tree.children[p], row);
+    addRoot(tree, row);
+}
+
+// Hang the root `row` under the live process `ppid`, if there is one. A
+// parent that is already below `row` (pid reuse racing the scan) leaves it
+// a root.
+void attach(ProcTree &tree, uint32_t row, int ppid)
+{
+    tree.ppid[row] = ppid;
+    auto it = tree.rowOfPid.find(ppid);
+    if (it == tree.rowOfPid.end()) return;
+    uint32_t p = it->second;
+    for (uint32_t a = p; a != ProcTree::none; a = tree.parent[a]) {
+        if (a == row) return;
+    }
+    unlink(tree, tree.roots, row);
+    tree.parent[row] = p;
+    tree.slot[row] = (uint32_t)tree.children[p].size();
+    tree.children[p].push_back(row);
+    tree.subtreeCpu[p] += tree.subtreeCpu[row];
+    tree.subtreeRss[p] += tree.subtreeRss[row];
+    addToAncestors(tree, p, tree.subtreeCpu[row], tree.subtreeRss[row]);
+}
+
+void addRow(ProcTree &tree, const ProcTable &table, uint32_t row)
+{
+    if (tree.parent.size() < table.size()) {
+        tree.parent.resize(table.size(), ProcTree::none);
+        tree.children.resize(table.size());
+        tree.slot.resize(table.size());
+        tree.ppid.resize(table.size());
+        tree.cpu.resize(table.size());
+        tree.rss.resize(table.size());
+        tree.subtreeCpu.resize(table.size());
+        tree.subtreeRss.resize(table.size());
+    }
+    addRoot(tree, row);
+    tree.children[row].clear();
+    tree.cpu[row] = table.cpuPercent[row];
+    tree.rss[row] = table.rss[row];
+    tree.subtreeCpu[row] = tree.cpu[row];
+    tree.subtreeRss[row] = tree.rss[row];
+    tree.rowOfPid[table.pid[row]] = row;
+}
+
+}  // namespace
+
+bool updateProcTree(ProcTree &tree, const ProcSnapshot &snap)
+{
+    const ProcTable &table = snap.table;
+    if (snap.generation == tree.generation) return false;
+
+    if (tree.generation == 0 || snap.generation > tree.generation + 1) {
+        // First use or a missed refresh: build from the whole table
+        tree.rowOfPid.clear();
+        tree.roots.clear();
+        for (uint32_t row = 0; row < table.size(); row++) {
+            if (table.alive[row]) addRow(tree, table, row);
+        }
+        for (uint32_t row = 0; row < table.size(); row++) {
+            if (table.alive[row]) attach(tree, row, table.ppid[row]);
+        }
+        tree.generation = snap.generation;
+        return true;
+    }
+
+    // Exits: the subtree comes off its parent and the children become
+    // roots until the rows reparented to a reaper arrive as updates.
+    for (const ProcChange &change : snap.changes.removed) {
+        uint32_t row = change.row;
+        detach(tree, row);
+        unlink(tree, tree.roots, row);
+        for (uint32_t child : tree.children[row]) {
+            addRoot(tree, child);
+        }
+        tree.children[row].clear();
+        auto it = tree.rowOfPid.find(change.key.pid);
+        if (it != tree.rowOfPid.end() && it->second == row) tree.rowOfPid.erase(it);
+    }
+    // Register every addition before attaching any, so a child scanned
+    // before its parent still finds it.
+    for (const ProcChange &change : snap.changes.added) {
+        addRow(tree, table, change.row);
+    }
+    for (const ProcChange &change : snap.changes.updated) {
+        uint32_t row = change.row;
+        bool reparent = table.ppid[row] != tree.ppid[row] || tree.parent[row] == ProcTree::none;
+        if (reparent) detach(tree, row);
+        double cpu = table.cpuPercent[row] - tree.cpu[row];
+        long long rss = table.rss[row] - tree.rss[row];
+        tree.cpu[row] = table.cpuPercent[row];
+        tree.rss[row] = table.rss[row];
+        tree.subtreeCpu[row] += cpu;
+        tree.subtreeRss[row] += rss;
+        if (reparent) {
+            attach(tree, row, table.ppid[row]);
+        } else {
+            addToAncestors(tree, row, cpu, rss);
+        }
+    }
+    for (const ProcChange &change : snap.changes.added) {
+        attach(tree, change.row, table.ppid[change.row]);
+    }
+    tree.generation = snap.generation;
+    return false;
+}
+
+namespace {
+
+void sortBySubtreeCpu(const ProcSnapshot &snap, const ProcTree &tree, vector<uint32_t> &rows)
+{
+    sort(rows.begin(), rows.end(), [&](uint32_t a, uint32_t b) {
+        if (tree.subtreeCpu[a] != tree.subtreeCpu[b]) return tree.subtreeCpu[a] > tree.subtreeCpu[b];
+        return snap.table.pid[a] < snap.table.pid[b];
+    });
+}
+
+void appendTreeLines(ProcTreeView &view, const ProcSnapshot &snap, const ProcTree &tree,
+                     const vector<uint32_t> &rows, int depth)
+{
+    for (uint32_t row : rows) {
+        view.lines.push_back({row, depth});
+        if (tree.children[row].empty() || !view.open.count(snap.table.key(row))) continue;
+        // Sorted the first time the node is laid out open this generation
+        auto it = view.order.find(row);
+        if (it == view.order.end()) {
+            it = view.order.emplace(row, tree.children[row]).first;
+            sortBySubtreeCpu(snap, tree, it->second);
+        }
+        appendTreeLines(view, snap, tree, it->second, depth + 1);
+    }
+}
+
+}  // namespace
+
+// Bring a sorted list of `owner`'s children (or of the roots) up to date
+// with `members` without sorting it again: rows that left are dropped and
+// rows that joined are appended, so the order only settles once per pass.
+static void syncTreeList(ProcTreeView &view, const ProcSnapshot &snap, const ProcTree &tree, uint32_t owner,
+                         const vector<uint32_t> &members, vector<uint32_t> &list)
+{
+    size_t out = 0;
+    for (uint32_t row : list) {
+        if (!snap.table.alive[row] || tree.parent[row] != owner) continue;
+        view.kept[row] = snap.generation;
+        list[out++] = row;
+    }
+    list.resize(out);
+    for (uint32_t row : members) {
+        if (view.kept[row] != snap.generation) list.push_back(row);
+    }
+}
+
+void layoutProcTree(ProcTreeView &view, const ProcSnapshot &snap, const ProcTree &tree)
+{
+    if (view.generation != snap.generation || snap.generation == 0) {
+        for (auto it = view.open.begin(); it != view.open.end();) {
+            it = snap.index.count(*it) ? next(it) : view.open.erase(it);
+        }
+        if (view.passes != snap.passes || view.generation == 0) {
+            view.roots = tree.roots;
+            sortBySubtreeCpu(snap, tree, view.roots);
+            view.order.clear();
+            view.passes = snap.passes;
+        } else {
+            view.kept.resize(snap.table.size());
+            syncTreeList(view, snap, tree, ProcTree::none, tree.roots, view.roots);
+            for (auto &entry : view.order) {
+                syncTreeList(view, snap, tree, entry.first, tree.children[entry.first], entry.second);
+            }
+        }
+        view.generation = snap.generation;
+        view.dirty = true;
+    }
+    if (!view.dirty) return;
+    // Only open nodes are walked, so closed subtrees cost nothing
+    view.lines.clear();
+    appendTreeLines(view, snap, tree, view.roots, 0);
+    view.dirty = false;
+}
+
+void updateProcIoRates(ProcIoRates &io, const ProcSnapshot &snap, const ProcSelection &sel)
+{
+    if (snap.generation == io.generation) return;
+    if (snap.generation > io.generation + 1) {
+        for (auto it = io.entries.begin(); it != io.entries.end();) {
+            it = snap.index.count(it->first) ? next(it) : io.entries.erase(it);
+        }
+    } else {
+        for (const ProcChange &change : snap.changes.removed) {
+            io.entries.erase(change.key);
+        }
+    }
+    io.generation = snap.generation;
+    // Rates are over whole sample intervals
+    if (snap.passes == io.passes) return;
+    io.passes = snap.passes;
+
+    // Rows drawn since the last refresh plus the selection, stalest first
+    const ProcTable &table = snap.table;
+    vector<uint32_t> &rows = io.wanted;
+    for (const auto &entry : sel.rows) {
+        rows.push_back(entry.second);
+    }
+    rows.erase(remove_if(rows.begin(), rows.end(), [&](uint32_t row) { return !table.alive[row]; }), rows.end());
+    sort(rows.begin(), rows.end());
+    rows.erase(unique(rows.begin(), rows.end()), rows.end());
+    auto lastRead = [&](uint32_t row) {
+        const ProcIoRates::Entry *entry = io.find(table.key(row));
+        return entry ? entry->generation : 0;
+    };
+    if ((int)rows.size() > io.budget) {
+        stable_sort(rows.begin(), rows.end(), [&](uint32_t a, uint32_t b) { return lastRead(a) < lastRead(b); });
+    }
+
+    io.readsLastRefresh = 0;
+    for (uint32_t row : rows) {
+        if (io.readsLastRefresh == io.budget) break;
+        ProcIoRates::Entry &entry = io.entries[table.key(row)];
+        if (entry.denied) continue;
+
+        ProcIoCounters counters;
+        io.readsLastRefresh++;
+        ProcIoStatus status = readProcIo("/proc", table.pid[row], counters);
+        if (status == PROC_IO_DENIED) {
+            entry.denied = true;
+            continue;
+        }
+        if (status != PROC_IO_OK) continue;
+
+        double timestamp = monotonicSeconds();
+        if (entry.generation != 0 && timestamp > entry.timestamp) {
+            double elapsed = timestamp - entry.timestamp;
+            entry.readBytes = (counters.readBytes - entry.counters.readBytes) / elapsed;
+            entry.writeBytes = (counters.writeBytes - entry.counters.writeBytes) / elapsed;
+            entry.syscr = (counters.syscr - entry.counters.syscr) / elapsed;
+            entry.syscw = (counters.syscw - entry.counters.syscw) / elapsed;
+            entry.hasRates = true;
+        }
+        entry.counters = counters;
+        entry.timestamp = timestamp;
+        entry.generation = snap.generation;
+    }
+    rows.clear();
+    io.round++;
+}
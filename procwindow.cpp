@@ -0,0 +1,234 @@
+#include "header.h"
+#include <algorithm>
+
+// Re-read an expanded process's threads at most once per complete pass,
+// when one of its lines is being drawn, so thread CPU% is over the same
+// interval as the process's. A process that exited since the snapshot is
+// left with no threads until a refresh drops its row.
+static void refreshVisibleThreads(ThreadList &list, const ProcSnapshot &snap)
+{
+    if (list.timestamp > 0 && list.passes == snap.passes) return;
+    list.passes = snap.passes;
+    refreshThreadList(list, "/proc");
+}
+
+void drawProcessRows(const ProcSnapshot &snap, const vector<uint32_t> &rows, long long ramTotal,
+                     ProcSelection &selection, ProcThreads &threads, ProcIoRates &io)
+{
+    const ProcTable &table = snap.table;
+
+    // One table line per process, plus one per thread of each expanded
+    // process. Without expansions the lines are just `rows`.
+    for (auto it = threads.lists.begin(); it != threads.lists.end();) {
+        it = snap.index.count(it->first) ? next(it) : threads.lists.erase(it);
+    }
+    threads.lines.clear();
+    if (!threads.lists.empty()) {
+        for (uint32_t row : rows) {
+            threads.lines.push_back({row, -1});
+            auto it = threads.lists.find(table.key(row));
+            if (it == threads.lists.end()) continue;
+            for (int t = 0; t < (int)it->second.threads.size(); t++) {
+                threads.lines.push_back({row, t});
+            }
+        }
+    }
+    bool expansions = !threads.lists.empty();
+    int lineCount = expansions ? (int)threads.lines.size() : (int)rows.size();
+
+    ImGuiListClipper clipper;
+    clipper.Begin(lineCount);
+    while (clipper.Step()) {
+        for (int n = clipper.DisplayStart; n < clipper.DisplayEnd; n++) {
+            uint32_t i = expansions ? threads.lines[n].first : rows[n];
+            int thread = expansions ? threads.lines[n].second : -1;
+
+            ImGui::TableNextRow();
+
+            if (thread >= 0) {
+                // Thread line. The list may shrink when it is re-read here,
+                // after the lines were laid out.
+                ThreadList &list = threads.lists[table.key(i)];
+                refreshVisibleThreads(list, snap);
+                if (thread >= (int)list.threads.size()) continue;
+                const Proc &t = list.threads[thread];
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("  %d", t.pid);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("  %s", t.name.c_str());
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%c", t.state);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%.1f", t.cpu_percent);
+                continue;
+            }
+
+            ImGui::PushID((int)i);
+
+            // Selectable row; the expand button on top of it takes its own clicks
+            ProcKey key = table.key(i);
+            ImGui::TableSetColumnIndex(0);
+            if (ImGui::Selectable("##row", selection.contains(key),
+                                  ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowItemOverlap)) {
+                selectProc(selection, snap, i, ImGui::GetIO().KeyCtrl);
+            }
+
+            ImGui::SameLine();
+            ImGui::Text("%d", table.pid[i]);
+
+            ImGui::TableSetColumnIndex(1);
+            auto expanded = threads.lists.find(key);
+            if (ImGui::SmallButton(expanded != threads.lists.end() ? "-" : "+")) {
+                if (expanded != threads.lists.end()) {
+                    threads.lists.erase(expanded);
+                } else {
+                    ThreadList &list = threads.lists[key];
+                    list.key = key;
+                    refreshVisibleThreads(list, snap);
+                }
+            } else if (expanded != threads.lists.end()) {
+                refreshVisibleThreads(expanded->second, snap);
+            }
+            ImGui::SameLine();
+            ImGui::TextUnformatted(snap.names.get(table.nameId[i]).c_str());
+
+            ImGui::TableSetColumnIndex(2);
+            ImGui::TextUnformatted(userName(table.uid[i]).c_str());
+
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%c", table.state[i]);
+
+            ImGui::TableSetColumnIndex(4);
+            ImGui::Text("%.1f", table.cpuPercent[i]);
+
+            ImGui::TableSetColumnIndex(5);
+            float memPercent = ramTotal > 0 ? (float)(table.rss[i] * getPageSize()) / ramTotal * 100.0f : 0.0f;
+            ImGui::Text("%.1f", memPercent);
+
+            // I/O is only sampled for rows that get drawn
+            io.want(i);
+            const ProcIoRates::Entry *rates = io.find(key);
+            if (rates && rates->denied) {
+                for (int column = 6; column < 10; column++) {
+                    ImGui::TableSetColumnIndex(column);
+                    ImGui::TextDisabled("-");
+                }
+            } else if (rates && rates->hasRates) {
+                ImGui::TableSetColumnIndex(6);
+                ImGui::TextUnformatted(formatBytes((long long)rates->readBytes).c_str());
+                ImGui::TableSetColumnIndex(7);
+                ImGui::TextUnformatted(formatBytes((long long)rates->writeBytes).c_str());
+                ImGui::TableSetColumnIndex(8);
+                ImGui::Text("%.0f", rates->syscr);
+                ImGui::TableSetColumnIndex(9);
+                ImGui::Text("%.0f", rates->syscw);
+            }
+
+            ImGui::TableSetColumnIndex(10);
+            ImGui::Text("%.0f", table.minfltRate[i]);
+            ImGui::TableSetColumnIndex(11);
+            ImGui::Text("%.0f", table.majfltRate[i]);
+            // -1 until the status file has been read for this process
+            if (table.ctxtVoluntary[i] >= 0) {
+                ImGui::TableSetColumnIndex(12);
+                ImGui::Text("%.0f", table.ctxtVoluntaryRate[i]);
+                ImGui::TableSetColumnIndex(13);
+                ImGui::Text("%.0f", table.ctxtInvoluntaryRate[i]);
+            }
+
+            ImGui::PopID();
+        }
+    }
+}
+
+void drawProcessTree(const ProcSnapshot &snap, const ProcTree &tree, ProcTreeView &view)
+{
+    const ProcTable &table = snap.table;
+
+    layoutProcTree(view, snap, tree);
+
+    const float indent = ImGui::GetStyle().IndentSpacing;
+    ImGuiListClipper clipper;
+    clipper.Begin((int)view.lines.size());
+    while (clipper.Step()) {
+        for (int n = clipper.DisplayStart; n < clipper.DisplayEnd; n++) {
+            uint32_t row = view.lines[n].first;
+            int depth = view.lines[n].second;
+            ProcKey key = table.key(row);
+
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::PushID((int)row);
+            if (depth > 0) ImGui::Indent(depth * indent);
+            ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+            if (tree.children[row].empty()) flags |= ImGuiTreeNodeFlags_Leaf;
+            bool open = view.open.count(key) != 0;
+            ImGui::SetNextItemOpen(open);
+            if (ImGui::TreeNodeEx("##node", flags, "%s", snap.names.get(table.nameId[row]).c_str()) != open) {
+                if (open) {
+                    view.open.erase(key);
+                } else {
+                    view.open.insert(key);
+                }
+                view.dirty = true;
+            }
+            if (depth > 0) ImGui::Unindent(depth * indent);
+            ImGui::PopID();
+
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%d", table.pid[row]);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%zu", tree.children[row].size());
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%.1f", tree.subtreeCpu[row]);
+            ImGui::TableSetColumnIndex(4);
+            ImGui::TextUnformatted(formatBytes(tree.subtreeRss[row] * getPageSize()).c_str());
+        }
+    }
+}
+
+void drawTopConsumers(const ProcSnapshot &snap, const ProcTopN &top)
+{
+    const ProcTable &table = snap.table;
+    // Field 42 only counts with delay accounting on; checked once per pass
+    static unsigned long checkedPass = 0;
+    static bool delayAccounting = false;
+    if (checkedPass != snap.passes) {
+        checkedPass = snap.passes;
+        delayAccounting = delayAccountingEnabled();
+    }
+
+    const char *titles[PROC_TOP_METRICS] = {"Top CPU", "Top Memory", "Top I/O Wait"};
+    ImGuiTableFlags flags = ImGuiTableFlags_BordersInnerV;
+    if (!ImGui::BeginTable("TopConsumers", PROC_TOP_METRICS, flags)) return;
+    for (int metric = 0; metric < PROC_TOP_METRICS; metric++) {
+        ImGui::TableSetupColumn(titles[metric]);
+    }
+    ImGui::TableHeadersRow();
+    size_t lines = 0;
+    for (const vector<uint32_t> &rows : top.rows) {
+        lines = max(lines, rows.size());
+    }
+    lines = max(lines, (size_t)1);  // room for the I/O wait note
+    for (size_t i = 0; i < lines; i++) {
+        ImGui::TableNextRow();
+        for (int metric = 0; metric < PROC_TOP_METRICS; metric++) {
+            ImGui::TableSetColumnIndex(metric);
+            if (i >= top.rows[metric].size()) {
+                if (i == 0 && metric == PROC_TOP_IO_WAIT) {
+                    ImGui::TextDisabled(delayAccounting ? "No I/O waits" : "Needs kernel.task_delayacct=1");
+                }
+                continue;
+            }
+            uint32_t row = top.rows[metric][i];
+            const char *name = snap.names.get(table.nameId[row]).c_str();
+            if (metric == PROC_TOP_RSS) {
+                ImGui::Text("%s %s", formatBytes(table.rss[row] * getPageSize()).c_str(), name);
+            } else {
+                float value = metric == PROC_TOP_CPU ? table.cpuPercent[row] : table.ioWait[row];
+                ImGui::Text("%5.1f%% %s", value, name);
+            }
+        }
+    }
+    ImGui::EndTable();
+}
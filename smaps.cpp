@@ -0,0 +1,196 @@
+#include "header.h"
+#include <cstring>
+#include <fcntl.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+bool parseSmapsRollup(const char *buf, size_t len, SmapsRollup &out)
+{
+    long long sharedClean = 0, sharedDirty = 0, privateClean = 0, privateDirty = 0;
+    const struct {
+        const char *key;
+        long long *value;
+    } fields[] = {
+        {"Rss:", &out.rss},
+        {"Pss:", &out.pss},
+        {"Shared_Clean:", &sharedClean},
+        {"Shared_Dirty:", &sharedDirty},
+        {"Private_Clean:", &privateClean},
+        {"Private_Dirty:", &privateDirty},
+        {"Swap:", &out.swap},
+        {"SwapPss:", &out.swapPss},
+    };
+    unsigned found = 0;
+    const char *p = buf;
+    const char *end = buf + len;
+    while (p < end) {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+            size_t keyLen = strlen(fields[f].key);
+            if ((size_t)(eol - p) > keyLen && memcmp(p, fields[f].key, keyLen) == 0) {
+                // "Key:   1234 kB"
+                *fields[f].value = strtoll(p + keyLen, nullptr, 10) * 1024;
+                found |= 1u << f;
+                break;
+            }
+        }
+        p = eol + 1;
+    }
+    out.shared = sharedClean + sharedDirty;
+    out.uss = privateClean + privateDirty;
+    // Rss, Pss and the four Shared_/Private_ lines
+    return (found & 0x3f) == 0x3f;
+}
+
+// Is the process behind the /proc/[pid] directory `pidDir` the one that
+// started at `starttime`?
+static bool startedAt(int pidDir, unsigned long long starttime)
+{
+    int fd = openat(pidDir, "stat", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char buf[1024];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    close(fd);
+    Proc proc = Proc();
+    return n > 0 && parseProcStat(buf, n, proc, false) == PROC_STAT_OK && proc.starttime == starttime;
+}
+
+bool readSmapsRollup(const ProcKey &key, SmapsRollup &out)
+{
+    // Files opened through the directory fd belong to the process it was
+    // opened for, so stat and smaps_rollup describe the same one
+    int dir = openPidFile(procDirFd(), key.pid, "", O_DIRECTORY);
+    if (dir < 0) return false;
+    bool ok = false;
+    if (startedAt(dir, key.starttime)) {
+        int fd = openat(dir, "smaps_rollup", O_RDONLY | O_CLOEXEC);
+        char buf[4096];
+        ssize_t n = fd < 0 ? -1 : read(fd, buf, sizeof(buf) - 1);
+        if (fd >= 0) close(fd);
+        if (n > 0) {
+            buf[n] = '\0';
+            out = SmapsRollup();
+            // The walk takes milliseconds; check the pid was not reused
+            // while it ran
+            ok = parseSmapsRollup(buf, n, out) && startedAt(dir, key.starttime);
+        }
+    }
+    close(dir);
+    return ok;
+}
+
+// The background reader. Requests and results cross threads only under
+// `m`; the file reads themselves happen outside the lock.
+class SmapsWorker
+{
+public:
+    ~SmapsWorker()
+    {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    void request(const vector<ProcKey> &keys)
+    {
+        {
+            lock_guard<mutex> lock(m);
+            requested = keys;
+            budgetMs = procOptions.smapsBudgetMs;
+            requestedRound++;
+        }
+        if (!worker.joinable()) {
+            worker = thread([this] { loop(); });
+        }
+        wake.notify_all();
+    }
+
+    void poll()
+    {
+        {
+            lock_guard<mutex> lock(m);
+            for (auto &entry : finished) {
+                published[entry.first] = entry.second;
+            }
+            finished.clear();
+            live.clear();
+            live.insert(requested.begin(), requested.end());
+        }
+        for (auto it = published.begin(); it != published.end();) {
+            it = live.count(it->first) ? next(it) : published.erase(it);
+        }
+    }
+
+    const unordered_map<ProcKey, SmapsRollup, ProcKeyHash> &results() const { return published; }
+
+private:
+    void loop()
+    {
+        vector<ProcKey> keys;
+        size_t cursor = 0;
+        unsigned long round = 0;
+        while (true) {
+            int budget;
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait(lock, [&] { return stopping || requestedRound != round; });
+                if (stopping) return;
+                round = requestedRound;
+                keys = requested;
+                budget = budgetMs;
+            }
+
+            // Resume after the last process read, so a budget too small for
+            // every request still reaches all of them over a few rounds
+            auto deadline = chrono::steady_clock::now() + chrono::milliseconds(budget);
+            vector<pair<ProcKey, SmapsRollup>> done;
+            size_t i = 0;
+            for (; i < keys.size() && chrono::steady_clock::now() < deadline; i++) {
+                const ProcKey &key = keys[(cursor + i) % keys.size()];
+                SmapsRollup rollup;
+                if (readSmapsRollup(key, rollup)) done.push_back({key, rollup});
+            }
+            if (!keys.empty()) cursor = (cursor + i) % keys.size();
+
+            lock_guard<mutex> lock(m);
+            for (auto &entry : done) {
+                finished[entry.first] = entry.second;
+            }
+        }
+    }
+
+    thread worker;
+    mutex m;
+    condition_variable wake;
+    bool stopping = false;
+    vector<ProcKey> requested;
+    int budgetMs = 0;
+    unsigned long requestedRound = 0;
+    unordered_map<ProcKey, SmapsRollup, ProcKeyHash> finished;  // read, not yet polled
+    // UI thread only
+    unordered_map<ProcKey, SmapsRollup, ProcKeyHash> published;
+    unordered_set<ProcKey, ProcKeyHash> live;
+};
+
+static SmapsWorker smapsWorker;
+
+void requestSmaps(const vector<ProcKey> &keys)
+{
+    smapsWorker.request(keys);
+}
+
+void pollSmaps()
+{
+    smapsWorker.poll();
+}
+
+const unordered_map<ProcKey, SmapsRollup, ProcKeyHash> &getSmaps()
+{
+    return smapsWorker.results();
+}
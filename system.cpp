@@ -1,9 +1,16 @@
 #include "header.h"
 #include <cstdlib>
 #include <cstring>
-#include <pwd.h>
+#include <algorithm>
 #include <sys/types.h>
 
+double monotonicSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
 string CPUinfo()
 {
     ifstream file("/proc/cpuinfo");
@@ -44,21 +51,9 @@ string getUsername()
     if (user && strlen(user) > 0) {
         return string(user);
     }
-    
-    // Fallback to getlogin() or getpwuid()
-    char* login = getlogin();
-    if (login) {
-        return string(login);
-    }
-    
-    // Final fallback to uid lookup
-    uid_t uid = getuid();
-    struct passwd* pw = getpwuid(uid);
-    if (pw) {
-        return string(pw->pw_name);
-    }
-    
-    return "Unknown";
+
+    // Called every frame, so go through the cache rather than NSS
+    return userName(getuid());
 }
 
 string getHostname()
@@ -72,44 +67,18 @@ string getHostname()
 
 TaskCounts getTaskCounts()
 {
-    TaskCounts counts = {0, 0, 0, 0, 0};
-    
-    DIR* proc_dir = opendir("/proc");
-    if (proc_dir) {
-        struct dirent* entry;
-        while ((entry = readdir(proc_dir)) != nullptr) {
-            if (isdigit(entry->d_name[0])) {
-                string stat_path = "/proc/" + string(entry->d_name) + "/stat";
-                ifstream stat_file(stat_path);
-                if (stat_file.is_open()) {
-                    string line;
-                    getline(stat_file, line);
-                    if (!line.empty()) {
-                        char state;
-                        sscanf(line.c_str(), "%*d %*s %c", &state);
-                        counts.total++;
-                        switch (state) {
-                            case 'R': counts.running++; break;
-                            case 'S': case 'D': case 'I': counts.sleeping++; break;
-                            case 'T': case 't': counts.stopped++; break;
-                            case 'Z': counts.zombie++; break;
-                        }
-                    }
-                }
-            }
-        }
-        closedir(proc_dir);
-    }
-    return counts;
+    return getProcSnapshot().tasks;
 }
 
 CPUStats getCPUStats()
 {
+    static ProcFile file("/proc/stat");
     CPUStats stats = {0};
-    ifstream file("/proc/stat");
-    string line;
-    if (getline(file, line) && line.find("cpu") == 0) {
-        sscanf(line.c_str(), "cpu %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+    if (!file.read()) return stats;
+
+    char *line = file.nextLine();
+    if (line && strncmp(line, "cpu", 3) == 0) {
+        sscanf(line, "cpu %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
                &stats.user, &stats.nice, &stats.system, &stats.idle,
                &stats.iowait, &stats.irq, &stats.softirq, &stats.steal,
                &stats.guest, &stats.guestNice);
@@ -117,11 +86,9 @@ CPUStats getCPUStats()
     return stats;
 }
 
-float calculateCPUUsage()
+// Busy % between two samples of the same counters
+static float busyPercent(const CPUStats &prev, const CPUStats &curr)
 {
-    static CPUStats prev = {0};
-    CPUStats curr = getCPUStats();
-    
     long long prevIdle = prev.idle + prev.iowait;
     long long currIdle = curr.idle + curr.iowait;
     
@@ -138,30 +105,173 @@ float calculateCPUUsage()
     if (totalDiff > 0) {
         usage = (float)(totalDiff - idleDiff) / totalDiff * 100.0f;
     }
-    
+    return usage;
+}
+
+float calculateCPUUsage()
+{
+    static CPUStats prev = {0};
+    CPUStats curr = getCPUStats();
+    float usage = busyPercent(prev, curr);
     prev = curr;
     return usage;
 }
 
+bool parseCpuStatLine(const char *line, int &cpu, CPUStats &stats)
+{
+    if (strncmp(line, "cpu", 3) != 0) return false;
+    const char *p = line + 3;
+    cpu = -1;
+    if (*p >= '0' && *p <= '9') {
+        cpu = 0;
+        while (*p >= '0' && *p <= '9') cpu = cpu * 10 + (*p++ - '0');
+    }
+    if (*p != ' ') return false;
+
+    // Older kernels stop after fewer columns; the missing ones stay zero
+    long long *fields[] = {&stats.user, &stats.nice, &stats.system, &stats.idle, &stats.iowait,
+                           &stats.irq, &stats.softirq, &stats.steal, &stats.guest, &stats.guestNice};
+    stats = CPUStats();
+    int parsed = 0;
+    for (long long *field : fields) {
+        while (*p == ' ') p++;
+        if (*p < '0' || *p > '9') break;
+        long long value = 0;
+        while (*p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+        *field = value;
+        parsed++;
+    }
+    return parsed >= 4;
+}
+
+void CoreStats::setCore(int core, const CPUStats &values)
+{
+    ticks[CPU_USER][core] = values.user;
+    ticks[CPU_NICE][core] = values.nice;
+    ticks[CPU_SYSTEM][core] = values.system;
+    ticks[CPU_IRQ][core] = values.irq;
+    ticks[CPU_SOFTIRQ][core] = values.softirq;
+    ticks[CPU_STEAL][core] = values.steal;
+    ticks[CPU_IOWAIT][core] = values.iowait;
+    ticks[CPU_IDLE][core] = values.idle;
+}
+
+bool readCoreStats(CoreStats &stats)
+{
+    static ProcFile file("/proc/stat");
+    stats.count = 0;
+    if (!file.read()) return false;
+
+    // The cpu lines come first; stop at the first line after them
+    bool any = false;
+    while (char *line = file.nextLine()) {
+        int cpu;
+        CPUStats values;
+        if (!parseCpuStatLine(line, cpu, values)) {
+            if (any) break;
+            continue;
+        }
+        any = true;
+        if (cpu < 0) {
+            stats.total = values;
+        } else if (cpu < CoreStats::maxCores) {
+            // Cores that are offline have no line, so clear any gap
+            for (int gap = stats.count; gap < cpu; gap++) stats.setCore(gap, CPUStats());
+            stats.setCore(cpu, values);
+            stats.count = max(stats.count, cpu + 1);
+        }
+    }
+    return any;
+}
+
+const char *cpuComponentName(int component)
+{
+    static const char *names[CPU_COMPONENTS] = {"user", "nice", "system", "irq", "softirq", "steal", "iowait", "idle"};
+    return component >= 0 && component < CPU_COMPONENTS ? names[component] : "";
+}
+
+// Counter deltas of the aggregate line in CpuComponent order, clamped at
+// zero (iowait can go backwards)
+static void componentDeltas(const CPUStats &prev, const CPUStats &curr, float *delta)
+{
+    const long long values[CPU_COMPONENTS] = {
+        curr.user - prev.user, curr.nice - prev.nice, curr.system - prev.system, curr.irq - prev.irq,
+        curr.softirq - prev.softirq, curr.steal - prev.steal, curr.iowait - prev.iowait, curr.idle - prev.idle,
+    };
+    for (int c = 0; c < CPU_COMPONENTS; c++) {
+        delta[c] = values[c] > 0 ? (float)values[c] : 0.0f;
+    }
+}
+
+void computeCoreUsage(const CoreStats &prev, const CoreStats &curr, CoreUsage &usage)
+{
+    const int lanes = CoreStats::maxCores;
+    usage.count = curr.count;
+
+    float total[CPU_COMPONENTS];
+    componentDeltas(prev.total, curr.total, total);
+    float sum = 0;
+    for (float d : total) sum += d;
+    float scale = sum > 0 ? 100.0f / sum : 0.0f;
+    for (int c = 0; c < CPU_COMPONENTS; c++) usage.totalBreakdown[c] = total[c] * scale;
+    usage.total = 100.0f * (sum > 0) - usage.totalBreakdown[CPU_IOWAIT] - usage.totalBreakdown[CPU_IDLE];
+
+    // Fixed-length loops over all lanes. Deltas over one interval fit in 32
+    // bits, and narrowing first keeps the conversion to float vectorizable;
+    // negative ones (per-core iowait can go backwards) are clamped to zero.
+    float (&delta)[CPU_COMPONENTS][lanes] = usage.breakdown;
+    for (int c = 0; c < CPU_COMPONENTS; c++) {
+        const long long *before = prev.ticks[c], *after = curr.ticks[c];
+        for (int i = 0; i < lanes; i++) {
+            int d = (int)(after[i] - before[i]);
+            delta[c][i] = (float)(d > 0 ? d : 0);
+        }
+    }
+    // A core that came online since the last sample has no interval yet
+    int cores = min(curr.count, prev.count);
+    for (int c = 0; c < CPU_COMPONENTS; c++) {
+        fill(delta[c] + cores, delta[c] + lanes, 0.0f);
+    }
+
+    float scales[lanes];
+    for (int i = 0; i < lanes; i++) scales[i] = 0;
+    for (int c = 0; c < CPU_COMPONENTS; c++) {
+        for (int i = 0; i < lanes; i++) scales[i] += delta[c][i];
+    }
+    for (int i = 0; i < lanes; i++) {
+        float busy = scales[i] - delta[CPU_IOWAIT][i] - delta[CPU_IDLE][i];
+        scales[i] = scales[i] > 0 ? 100.0f / scales[i] : 0.0f;
+        usage.cores[i] = busy * scales[i];
+    }
+    for (int c = 0; c < CPU_COMPONENTS; c++) {
+        for (int i = 0; i < lanes; i++) delta[c][i] *= scales[i];
+    }
+}
+
+const CoreUsage &sampleCoreUsage()
+{
+    static CoreStats prev = CoreStats(), curr = CoreStats();
+    static CoreUsage usage = CoreUsage();
+    if (!readCoreStats(curr)) return usage;
+    computeCoreUsage(prev, curr, usage);
+    swap(prev, curr);
+    return usage;
+}
+
 float getThermalTemp()
 {
-    ifstream file("/proc/acpi/ibm/thermal");
-    if (file.is_open()) {
-        string line;
-        getline(file, line);
-        if (line.find("temperatures:") != string::npos) {
-            int temp;
-            if (sscanf(line.c_str(), "temperatures: %d", &temp) == 1) {
-                return (float)temp;
-            }
+    static ProcFile ibm("/proc/acpi/ibm/thermal");
+    if (ibm.read()) {
+        char *line = ibm.nextLine();
+        int temp;
+        if (line && sscanf(line, "temperatures: %d", &temp) == 1) {
+            return (float)temp;
         }
     }
     
-    ifstream hwmon("/sys/class/thermal/thermal_zone0/temp");
-    if (hwmon.is_open()) {
-        int temp;
-        hwmon >> temp;
-        return temp / 1000.0f;
+    static ProcFile hwmon("/sys/class/thermal/thermal_zone0/temp");
+    if (hwmon.read()) {
+        return atoi(hwmon.data()) / 1000.0f;
     }
     
     return 0.0f;
@@ -169,17 +279,17 @@ float getThermalTemp()
 
 FanInfo getFanInfo()
 {
+    static ProcFile file("/proc/acpi/ibm/fan");
     FanInfo info = {false, 0, 0};
-    ifstream file("/proc/acpi/ibm/fan");
-    if (file.is_open()) {
-        string line;
-        while (getline(file, line)) {
-            if (line.find("status:") != string::npos) {
-                info.enabled = line.find("enabled") != string::npos;
-            } else if (line.find("speed:") != string::npos) {
-                sscanf(line.c_str(), "speed: %d", &info.speed);
-            } else if (line.find("level:") != string::npos) {
-                sscanf(line.c_str(), "level: %d", &info.level);
+    if (file.read()) {
+        char *line;
+        while ((line = file.nextLine()) != nullptr) {
+            if (strncmp(line, "status:", 7) == 0) {
+                info.enabled = strstr(line, "enabled") != nullptr;
+            } else if (strncmp(line, "speed:", 6) == 0) {
+                sscanf(line, "speed: %d", &info.speed);
+            } else if (strncmp(line, "level:", 6) == 0) {
+                sscanf(line, "level: %d", &info.level);
             }
         }
     }
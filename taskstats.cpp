@@ -0,0 +1,269 @@
+#include "header.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+
+// One generic-netlink socket per group of CPUs, each registered as an exit
+// listener for its CPUs, so a burst of exits on many cores is spread over
+// several receive buffers instead of overflowing one.
+static const int cpusPerListener = 32;
+static vector<int> listeners;
+static int familyId = -1;
+
+// Aggregated exits, bounded at maxExitedCommands entries (the least
+// recently updated command is evicted to make room)
+static const size_t maxExitedCommands = 256;
+static vector<ExitedCommand> exited;
+static unordered_map<string, size_t> exitedIndex;
+static long long exitOverflows = 0;
+
+static void addAttr(struct nlmsghdr *hdr, unsigned short type, const void *data, size_t len)
+{
+    struct nlattr *attr = (struct nlattr *)((char *)hdr + NLMSG_ALIGN(hdr->nlmsg_len));
+    attr->nla_type = type;
+    attr->nla_len = NLA_HDRLEN + len;
+    memcpy((char *)attr + NLA_HDRLEN, data, len);
+    hdr->nlmsg_len = NLMSG_ALIGN(hdr->nlmsg_len) + NLA_ALIGN(attr->nla_len);
+}
+
+static bool sendGenl(int sock, int family, unsigned char cmd, unsigned short attrType, const void *data, size_t len,
+                     unsigned short flags = 0)
+{
+    alignas(struct nlmsghdr) char req[256] = {};
+    struct nlmsghdr *hdr = (struct nlmsghdr *)req;
+    hdr->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    hdr->nlmsg_type = family;
+    hdr->nlmsg_flags = NLM_F_REQUEST | flags;
+    struct genlmsghdr *genl = (struct genlmsghdr *)NLMSG_DATA(hdr);
+    genl->cmd = cmd;
+    genl->version = 1;
+    addAttr(hdr, attrType, data, len);
+
+    struct sockaddr_nl kernel = {};
+    kernel.nl_family = AF_NETLINK;
+    return sendto(sock, req, hdr->nlmsg_len, 0, (struct sockaddr *)&kernel, sizeof(kernel)) >= 0;
+}
+
+// Walk the attributes in [data, data + len), calling fn(type, payload, size)
+template <typename F>
+static void forEachAttr(const char *data, int len, F fn)
+{
+    while (len >= NLA_HDRLEN) {
+        const struct nlattr *attr = (const struct nlattr *)data;
+        if (attr->nla_len < NLA_HDRLEN || attr->nla_len > len) return;
+        fn(attr->nla_type & NLA_TYPE_MASK, data + NLA_HDRLEN, attr->nla_len - NLA_HDRLEN);
+        int step = NLA_ALIGN(attr->nla_len);
+        data += step;
+        len -= step;
+    }
+}
+
+static int resolveFamily(int sock)
+{
+    if (!sendGenl(sock, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+                  TASKSTATS_GENL_NAME, sizeof(TASKSTATS_GENL_NAME))) {
+        return -1;
+    }
+
+    alignas(struct nlmsghdr) char buf[4096];
+    ssize_t n = recv(sock, buf, sizeof(buf), 0);
+    if (n <= 0) return -1;
+    struct nlmsghdr *hdr = (struct nlmsghdr *)buf;
+    if (!NLMSG_OK(hdr, (size_t)n) || hdr->nlmsg_type == NLMSG_ERROR) return -1;
+
+    int id = -1;
+    const char *attrs = (const char *)NLMSG_DATA(hdr) + GENL_HDRLEN;
+    forEachAttr(attrs, hdr->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN), [&](int type, const char *payload, int) {
+        if (type == CTRL_ATTR_FAMILY_ID) {
+            unsigned short value;
+            memcpy(&value, payload, sizeof(value));
+            id = value;
+        }
+    });
+    return id;
+}
+
+// Wait for the ack to a NLM_F_ACK request; returns its errno (0 = success).
+// Exit events that arrive before the ack are skipped.
+static int waitAck(int sock)
+{
+    alignas(struct nlmsghdr) char buf[8192];
+    while (true) {
+        ssize_t n = recv(sock, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EINTR || errno == ENOBUFS) continue;
+            return errno;
+        }
+        for (struct nlmsghdr *hdr = (struct nlmsghdr *)buf; NLMSG_OK(hdr, (size_t)n); hdr = NLMSG_NEXT(hdr, n)) {
+            if (hdr->nlmsg_type == NLMSG_ERROR) {
+                return -((struct nlmsgerr *)NLMSG_DATA(hdr))->error;
+            }
+        }
+    }
+}
+
+bool openTaskExits(string &error)
+{
+    closeTaskExits();
+
+    int cpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (int first = 0; first < cpus; first += cpusPerListener) {
+        int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+        if (sock < 0) {
+            error = string("socket: ") + strerror(errno);
+            closeTaskExits();
+            return false;
+        }
+        listeners.push_back(sock);
+
+        struct sockaddr_nl addr = {};
+        addr.nl_family = AF_NETLINK;
+        if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            error = string("bind: ") + strerror(errno);
+            closeTaskExits();
+            return false;
+        }
+
+        int rcvbuf = 4 << 20;
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        struct timeval timeout = {1, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        if (familyId < 0) {
+            familyId = resolveFamily(sock);
+            if (familyId < 0) {
+                error = "taskstats family not available";
+                closeTaskExits();
+                return false;
+            }
+        }
+
+        char mask[32];
+        snprintf(mask, sizeof(mask), "%d-%d", first, min(first + cpusPerListener, cpus) - 1);
+        // Registering needs CAP_NET_ADMIN
+        int err = 0;
+        if (!sendGenl(sock, familyId, TASKSTATS_CMD_GET, TASKSTATS_CMD_ATTR_REGISTER_CPUMASK,
+                      mask, strlen(mask) + 1, NLM_F_ACK)) {
+            err = errno;
+        } else {
+            err = waitAck(sock);
+        }
+        if (err) {
+            error = string("register: ") + strerror(err);
+            closeTaskExits();
+            return false;
+        }
+    }
+
+    error.clear();
+    return true;
+}
+
+void closeTaskExits()
+{
+    int cpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (size_t i = 0; i < listeners.size(); i++) {
+        if (familyId >= 0) {
+            int first = i * cpusPerListener;
+            char mask[32];
+            snprintf(mask, sizeof(mask), "%d-%d", first, min(first + cpusPerListener, cpus) - 1);
+            sendGenl(listeners[i], familyId, TASKSTATS_CMD_GET, TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK, mask, strlen(mask) + 1);
+        }
+        close(listeners[i]);
+    }
+    listeners.clear();
+}
+
+static void recordExit(const struct taskstats &stats)
+{
+    char comm[TS_COMM_LEN + 1];
+    memcpy(comm, stats.ac_comm, TS_COMM_LEN);
+    comm[TS_COMM_LEN] = '\0';
+
+    auto it = exitedIndex.find(comm);
+    size_t slot;
+    if (it != exitedIndex.end()) {
+        slot = it->second;
+    } else {
+        if (exited.size() < maxExitedCommands) {
+            slot = exited.size();
+            exited.emplace_back();
+        } else {
+            slot = 0;
+            for (size_t i = 1; i < exited.size(); i++) {
+                if (exited[i].lastExit < exited[slot].lastExit) slot = i;
+            }
+            exitedIndex.erase(exited[slot].name);
+        }
+        exited[slot] = ExitedCommand();
+        exited[slot].name = comm;
+        exitedIndex[exited[slot].name] = slot;
+    }
+
+    ExitedCommand &cmd = exited[slot];
+    cmd.tasks++;
+    cmd.cpuUsec += stats.ac_utime + stats.ac_stime;
+    cmd.maxRssKB = max(cmd.maxRssKB, (long long)stats.hiwater_rss);
+    cmd.readBytes += stats.read_bytes;
+    cmd.writeBytes += stats.write_bytes;
+    cmd.lastExit = monotonicSeconds();
+}
+
+void pollTaskExits()
+{
+    alignas(struct nlmsghdr) static char buf[65536];
+    for (int sock : listeners) {
+        while (true) {
+            ssize_t n = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == ENOBUFS) {
+                    exitOverflows++;
+                    continue;
+                }
+                break;
+            }
+
+            for (struct nlmsghdr *hdr = (struct nlmsghdr *)buf; NLMSG_OK(hdr, (size_t)n); hdr = NLMSG_NEXT(hdr, n)) {
+                if (hdr->nlmsg_type != familyId) continue;
+                const char *attrs = (const char *)NLMSG_DATA(hdr) + GENL_HDRLEN;
+                forEachAttr(attrs, hdr->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN), [](int type, const char *payload, int len) {
+                    // Per-task records only; the AGGR_TGID record sent when a
+                    // whole thread group exits would count its time twice
+                    if (type != TASKSTATS_TYPE_AGGR_PID) return;
+                    forEachAttr(payload, len, [](int inner, const char *data, int size) {
+                        if (inner != TASKSTATS_TYPE_STATS) return;
+                        // Older kernels send a shorter struct
+                        struct taskstats stats = {};
+                        memcpy(&stats, data, min((size_t)size, sizeof(stats)));
+                        recordExit(stats);
+                    });
+                });
+            }
+        }
+    }
+}
+
+bool taskExitsActive()
+{
+    return !listeners.empty();
+}
+
+const vector<ExitedCommand> &getExitedCommands()
+{
+    return exited;
+}
+
+long long getTaskExitOverflows()
+{
+    return exitOverflows;
+}
+
+void clearExitedCommands()
+{
+    exited.clear();
+    exitedIndex.clear();
+    exitOverflows = 0;
+}
@@ -1,96 +1,1231 @@
-#include <iostream>
-#include <fstream>
-#include <vector>
+#include "header.h"
 #include <string>
-#include <dirent.h>
-#include <unistd.h>
-#include <limits.h>
-#include <sys/types.h>
-#include <sys/sysinfo.h>
-#include <sys/statvfs.h>
-#include <ifaddrs.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <map>
 #include <pwd.h>
 #include <cstring>
 #include <cstdlib>
 #include <cctype>
+#include <algorithm>
+#include <csignal>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/prctl.h>
+#include <atomic>
+#include <thread>
 
-using namespace std;
+static int failures = 0;
 
-// Copy the structures and function declarations we need
-struct TaskCounts {
-    int total, running, sleeping, stopped, zombie;
-};
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cout << "  FAIL " << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; \
+            failures++; \
+        } \
+    } while (0)
 
-struct MemInfo {
-    long long total, available, used;
+// Golden /proc/[pid]/stat corpus: real-world lines plus the comm edge cases
+// a sscanf("%s") parser gets wrong.
+struct StatCase {
+    const char *line;
+    ProcStatError err;
+    int pid;
+    const char *name;
+    char state;
+    int ppid;
+    long long utime, stime;
+    unsigned long long starttime;
+    long long vsize, rss;
 };
 
-struct DiskInfo {
-    long long total, used, available;
+static const StatCase statCorpus[] = {
+    {"1 (systemd) S 0 1 1 0 -1 4194560 46511 3113573 108 1291 96 135 4532 1934 20 0 1 0 13 172023808 3226 18446744073709551615 1 1 0 0 0 0 671173123 4096 1260 0 0 0 17 2 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+     PROC_STAT_OK, 1, "systemd", 'S', 0, 96, 135, 13, 172023808, 3226},
+    {"4242 (tmux: server) S 1 4242 4242 0 -1 4194624 1123 0 0 0 250 91 0 0 20 0 1 0 98765 12345678 1024 18446744073709551615\n",
+     PROC_STAT_OK, 4242, "tmux: server", 'S', 1, 250, 91, 98765, 12345678, 1024},
+    {"31337 (Web Content) R 2000 1999 1999 0 -1 4194304 900000 0 12 0 123456 7890 0 0 20 0 41 0 555 4000000000 250000 0",
+     PROC_STAT_OK, 31337, "Web Content", 'R', 2000, 123456, 7890, 555, 4000000000LL, 250000},
+    {"77 (a) b) c) S 1 77 77 0 -1 0 0 0 0 0 1 2 0 0 20 0 1 0 3 4 5\n",
+     PROC_STAT_OK, 77, "a) b) c", 'S', 1, 1, 2, 3, 4, 5},
+    {"78 ((sd-pam)) S 1 78 78 0 -1 0 0 0 0 0 7 8 0 0 20 0 1 0 9 10 11\n",
+     PROC_STAT_OK, 78, "(sd-pam)", 'S', 1, 7, 8, 9, 10, 11},
+    {"79 () Z 1 79 79 0 -1 0 0 0 0 0 0 0 0 0 20 0 1 0 1 0 0\n",
+     PROC_STAT_OK, 79, "", 'Z', 1, 0, 0, 1, 0, 0},
+    {"80 (kworker/u16:0-events_unbound) I 2 0 0 0 -1 69238880 0 0 0 0 0 42 0 0 20 0 1 0 1000 0 0\n",
+     PROC_STAT_OK, 80, "kworker/u16:0-events_unbound", 'I', 2, 0, 42, 1000, 0, 0},
+    {"", PROC_STAT_BAD_PID},
+    {"abc (x) S 1", PROC_STAT_BAD_PID},
+    {"12 systemd S 1 2 3", PROC_STAT_NO_COMM},
+    {"12 (systemd S 1 2 3", PROC_STAT_NO_COMM},
+    {"12 (systemd)", PROC_STAT_BAD_STATE},
+    {"12 (systemd) S 1 2 3 4 5\n", PROC_STAT_TRUNCATED},
+    {"12 (systemd) S 1 2 3 4 x 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 21\n", PROC_STAT_BAD_FIELD},
 };
 
-struct IP4 {
-    char *name;
-    char addressBuffer[INET_ADDRSTRLEN];
-};
+static void testProcStatParser()
+{
+    std::cout << "Proc stat parser:" << std::endl;
 
-struct Networks {
-    vector<IP4> ip4s;
-};
+    for (const StatCase &c : statCorpus) {
+        Proc proc = {0};
+        ProcStatError err = parseProcStat(c.line, strlen(c.line), proc);
+        if (err != c.err) {
+            std::cout << "  FAIL \"" << c.line << "\": got " << procStatErrorName(err)
+                      << ", want " << procStatErrorName(c.err) << std::endl;
+            failures++;
+            continue;
+        }
+        if (err != PROC_STAT_OK) continue;
+        CHECK(proc.pid == c.pid);
+        CHECK(proc.name == c.name);
+        CHECK(proc.state == c.state);
+        CHECK(proc.ppid == c.ppid);
+        CHECK(proc.utime == c.utime);
+        CHECK(proc.stime == c.stime);
+        CHECK(proc.starttime == c.starttime);
+        CHECK(proc.vsize == c.vsize);
+        CHECK(proc.rss == c.rss);
+        CHECK(proc.blkioTicks == 0);
+    }
 
-struct RX {
-    long long bytes;
-    long long packets;
-    long long errs;
-    long long drop;
-    long long fifo;
-    long long frame;
-    long long compressed;
-    long long multicast;
-};
+    // Field 42 (delayacct_blkio_ticks) is read when the line reaches it
+    const char blkio[] = "1 (systemd) S 0 1 1 0 -1 4194560 46511 3113573 108 1291 96 135 4532 1934 20 0 1 0 13 "
+                         "172023808 3226 18446744073709551615 1 1 0 0 0 0 671173123 4096 1260 0 0 0 17 2 0 0 "
+                         "77 0 0 0 0 0 0 0 0 0 0\n";
+    Proc withBlkio = {0};
+    CHECK(parseProcStat(blkio, strlen(blkio), withBlkio) == PROC_STAT_OK);
+    CHECK(withBlkio.blkioTicks == 77 && withBlkio.rss == 3226);
+    CHECK(withBlkio.minflt == 46511 && withBlkio.majflt == 108);
+    CHECK(parseProcStat(blkio, strlen(blkio), withBlkio, false) == PROC_STAT_OK);
+    CHECK(withBlkio.blkioTicks == 0 && withBlkio.rss == 3226);
 
-struct TX {
-    long long bytes;
-    long long packets;
-    long long errs;
-    long long drop;
-    long long fifo;
-    long long colls;
-    long long carrier;
-    long long compressed;
-};
+    // Fuzz: truncate and corrupt the golden lines. The parser must never
+    // read past `len` (each input lives in an exactly-sized heap buffer so
+    // ASan builds catch overreads) and any OK result must be sane.
+    srand(1234);
+    int parsed = 0;
+    for (int i = 0; i < 200000; i++) {
+        const StatCase &c = statCorpus[rand() % (sizeof(statCorpus) / sizeof(statCorpus[0]))];
+        std::vector<char> input(c.line, c.line + strlen(c.line));
+        if (!input.empty()) {
+            input.resize(rand() % (input.size() + 1));
+            for (int flips = rand() % 4; flips > 0 && !input.empty(); flips--) {
+                input[rand() % input.size()] = (char)(rand() % 256);
+            }
+        }
+        std::vector<char> exact(input);
+        Proc proc = {0};
+        if (parseProcStat(exact.data(), exact.size(), proc) == PROC_STAT_OK) {
+            CHECK(proc.pid > 0);
+            CHECK(proc.name.size() < exact.size());
+            parsed++;
+        }
+    }
+    std::cout << "  " << sizeof(statCorpus) / sizeof(statCorpus[0]) << " golden lines, "
+              << parsed << "/200000 fuzzed lines parsed" << std::endl;
+}
 
-struct NetStats {
-    map<string, RX> rx;
-    map<string, TX> tx;
-};
+// The persistent table must stay internally consistent across refreshes:
+// one index entry per row, task counts matching the rows, and this test
+// process present under its (pid, starttime) key.
+static void testProcTable()
+{
+    std::cout << "Process table:" << std::endl;
+
+    refreshProcSnapshot();
+    refreshProcSnapshot();
+    const ProcSnapshot &snap = getProcSnapshot();
+
+    const ProcTable &table = snap.table;
+    CHECK(snap.index.size() == table.count());
+    CHECK(snap.tasks.total == (int)table.count());
+    bool foundSelf = false;
+    for (size_t row = 0; row < table.size(); row++) {
+        if (!table.alive[row]) continue;
+        auto it = snap.index.find(table.key(row));
+        CHECK(it != snap.index.end() && it->second == row);
+        CHECK(table.nameId[row] < snap.names.names.size() && snap.names.refs[table.nameId[row]] > 0);
+        foundSelf |= table.pid[row] == getpid();
+    }
+    CHECK(foundSelf);
+    for (const ProcChange &change : snap.changes.removed) {
+        CHECK(snap.index.find(change.key) == snap.index.end());
+        CHECK(!table.alive[change.row]);
+    }
+    // A child that comes and goes must show up as exactly one add and one removal
+    pid_t child = fork();
+    if (child == 0) {
+        pause();
+        _exit(0);
+    }
+    refreshProcSnapshot();
+    ProcKey childKey = {0, 0};
+    for (const ProcChange &change : snap.changes.added) {
+        if (change.key.pid == child) {
+            childKey = change.key;
+            CHECK(table.pid[change.row] == child);
+        }
+    }
+    CHECK(childKey.pid == child);
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    refreshProcSnapshot();
+    bool childRemoved = false;
+    for (const ProcChange &change : snap.changes.removed) {
+        childRemoved |= change.key == childKey;
+    }
+    CHECK(childRemoved);
+    CHECK(snap.index.find(childKey) == snap.index.end());
+
+    std::cout << "  " << table.count() << " rows, last refresh: +" << snap.changes.added.size()
+              << " -" << snap.changes.removed.size() << " ~" << snap.changes.updated.size() << std::endl;
+}
+
+// Under a tiny scan budget a refresh reads only part of the pid list and
+// the next one resumes there. Rows are not dropped mid-pass, and the
+// snapshot says how far the pass got and how old its data can be.
+static void testScanBudget()
+{
+    std::cout << "Scan budget:" << std::endl;
+
+    // Enough processes for several 16-pid batches
+    vector<pid_t> children;
+    for (int i = 0; i < 64; i++) {
+        pid_t child = fork();
+        if (child == 0) {
+            pause();
+            _exit(0);
+        }
+        children.push_back(child);
+    }
+    refreshProcSnapshot();
+    const ProcSnapshot &snap = getProcSnapshot();
+    CHECK(snap.scanProgress == 1.0f);
+    double lastComplete = snap.completedAt;
+    unsigned long lastPasses = snap.passes;
+    ProcSelection self;
+    for (uint32_t row = 0; row < snap.table.size(); row++) {
+        if (snap.table.alive[row] && snap.table.pid[row] == getpid()) selectProc(self, snap, row, false);
+    }
+    updateProcSelection(self, snap);
 
-struct FanInfo {
-    bool enabled;
-    int speed;
-    int level;
+    procOptions.scanBudgetUs = 1;
+    int refreshes = 0, partial = 0;
+    float progress = 0;
+    bool monotonic = true, dropped = false;
+    do {
+        refreshProcSnapshot();
+        updateProcSelection(self, snap);
+        refreshes++;
+        if (snap.scanProgress < 1.0f) {
+            partial++;
+            monotonic &= snap.scanProgress > progress;
+            progress = snap.scanProgress;
+            dropped |= !snap.changes.removed.empty();
+            CHECK(snap.completedAt == lastComplete && snap.timestamp > snap.completedAt);
+        }
+    } while (snap.scanProgress < 1.0f && refreshes < 10000);
+    procOptions.scanBudgetUs = 0;
+
+    CHECK(partial > 0 && monotonic && !dropped);
+    CHECK(snap.scanProgress == 1.0f && snap.completedAt > lastComplete);
+    // Partial refreshes add no history samples; the completed pass adds one
+    CHECK(snap.passes == lastPasses + 1);
+    CHECK(self.rows.size() == 1 && self.history.begin()->second.size() == 2);
+    size_t found = 0;
+    for (pid_t child : children) {
+        for (uint32_t row = 0; row < snap.table.size(); row++) {
+            if (snap.table.alive[row] && snap.table.pid[row] == child) {
+                found++;
+                break;
+            }
+        }
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+    }
+    CHECK(found == children.size());
+    std::cout << "  pass of " << snap.table.count() << " processes took " << refreshes << " refreshes" << std::endl;
+}
+
+// getdents64 listing: only all-digit names, every entry across several
+// buffer refills, and the same pids as readdir for /proc
+static void testListPids()
+{
+    std::cout << "Pid listing:" << std::endl;
+
+    char dir[] = "/tmp/monitor-test-pids-XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    const int count = 20000;
+    vector<string> names = {"self", "12a", "0x1f", "1234567890"};
+    for (int i = 1; i <= count; i++) names.push_back(to_string(i * 7));
+    for (const string &name : names) {
+        close(open((string(dir) + "/" + name).c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644));
+    }
+    vector<int> pids;
+    listPids(dir, pids);
+    sort(pids.begin(), pids.end());
+    CHECK(pids.size() == (size_t)count);
+    bool match = true;
+    for (int i = 0; i < (int)pids.size(); i++) match &= pids[i] == (i + 1) * 7;
+    CHECK(match);
+    for (const string &name : names) unlink((string(dir) + "/" + name).c_str());
+
+    // A listed pid whose directory has gone is reported back, so netlink
+    // tracking can forget it even if it never got a table row
+    mkdir((string(dir) + "/41").c_str(), 0755);
+    FILE *stat = fopen((string(dir) + "/41/stat").c_str(), "w");
+    fprintf(stat, "41 (worker) S 1 41 41 0 -1 4194304 0 0 0 0 3 4 0 0 20 0 1 0 500 4096 10 0\n");
+    fclose(stat);
+    vector<Proc> scanned;
+    vector<int> gone;
+    scanProcStats(dir, {41, 42}, 1, scanned, 0, 0, &gone);
+    CHECK(scanned.size() == 1 && scanned[0].pid == 41);
+    CHECK((gone == vector<int>{42}));
+    unlink((string(dir) + "/41/stat").c_str());
+    rmdir((string(dir) + "/41").c_str());
+    rmdir(dir);
+
+    // Processes may come and go between the two listings, so retry a few times
+    vector<int> expected;
+    for (int attempt = 0; attempt < 5 && (attempt == 0 || pids != expected); attempt++) {
+        expected.clear();
+        DIR *proc = opendir("/proc");
+        while (struct dirent *entry = readdir(proc)) {
+            if (isdigit(entry->d_name[0])) expected.push_back(atoi(entry->d_name));
+        }
+        closedir(proc);
+        listPids("/proc", pids);
+        sort(pids.begin(), pids.end());
+        sort(expected.begin(), expected.end());
+    }
+    CHECK(pids == expected);
+    CHECK(binary_search(pids.begin(), pids.end(), (int)getpid()));
+    std::cout << "  " << count << " synthetic entries, " << pids.size() << " pids in /proc" << std::endl;
+}
+
+// Wall time and a task's CPU time (from its CPU-time clock) at one moment
+struct CpuMark {
+    double wall, cpu;
 };
+static CpuMark cpuMark(clockid_t clock)
+{
+    struct timespec t;
+    clock_gettime(clock, &t);
+    return {monotonicSeconds(), t.tv_sec + t.tv_nsec / 1e9};
+}
+
+// Could a sampler that read the task once between marks `a` and `b`, and
+// again between `c` and `d`, have seen `reported` CPU%? The bounds hold
+// however much CPU the task got, so they do not depend on the machine being
+// idle; the slack covers the clock-tick rounding of /proc at both ends.
+static bool plausibleCpu(float reported, CpuMark a, CpuMark b, CpuMark c, CpuMark d)
+{
+    double slack = 2.0 / sysconf(_SC_CLK_TCK);
+    double low = (c.cpu - b.cpu - slack) / (d.wall - a.wall) * 100.0;
+    double high = (d.cpu - a.cpu + slack) / (c.wall - b.wall) * 100.0;
+    return reported >= low - 0.5 && reported <= high + 0.5;
+}
 
-// Function declarations
-string CPUinfo();
-const char *getOsName();
-string getUsername();
-string getHostname();
-TaskCounts getTaskCounts();
-float getThermalTemp();
-FanInfo getFanInfo();
-MemInfo getMemInfo();
-MemInfo getSwapInfo();
-DiskInfo getDiskInfo();
-Networks getNetworks();
-NetStats getNetStats();
-string formatBytes(long long bytes);
+// CPU% must reflect the last interval, not the process lifetime: a child
+// that spins for the whole interval reports the CPU time it actually got
+// over it, near 100% of one core on an idle machine.
+static void testIntervalCpu()
+{
+    std::cout << "Interval CPU%:" << std::endl;
+
+    pid_t child = fork();
+    if (child == 0) {
+        while (true) {
+        }
+    }
+    clockid_t childClock;
+    CHECK(clock_getcpuclockid(child, &childClock) == 0);
+    CpuMark a = cpuMark(childClock);
+    refreshProcSnapshot();
+    CpuMark b = cpuMark(childClock);
+    usleep(300000);
+    CpuMark c = cpuMark(childClock);
+    refreshProcSnapshot();
+    CpuMark d = cpuMark(childClock);
+
+    float childCpu = -1.0f, selfCpu = -1.0f;
+    for (const Proc &proc : getProcesses()) {
+        if (proc.pid == child) childCpu = proc.cpu_percent;
+        if (proc.pid == getpid()) selfCpu = proc.cpu_percent;
+    }
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+
+    CHECK(childCpu > 0.0f && plausibleCpu(childCpu, a, b, c, d));
+    CHECK(selfCpu >= 0.0f && selfCpu < 50.0f);
+    std::cout << "  spinning child: " << childCpu << "%, sleeping parent: " << selfCpu << "%" << std::endl;
+}
+
+// Context switch counters from status, and rates from two samples: a child
+// that sleeps in a loop switches voluntarily many times per second
+static void testCtxtSwitchRates()
+{
+    std::cout << "Context switch rates:" << std::endl;
+
+    const char golden[] = "Name:\tbash\nState:\tS (sleeping)\nVmRSS:\t    5120 kB\n"
+                          "voluntary_ctxt_switches:\t1523\nnonvoluntary_ctxt_switches:\t42\n";
+    long long voluntary = -1, involuntary = -1;
+    CHECK(parseProcStatusCtxt(golden, strlen(golden), voluntary, involuntary));
+    CHECK(voluntary == 1523 && involuntary == 42);
+    const char partial[] = "Name:\tbash\nvoluntary_ctxt_switches:\t1523\n";
+    CHECK(!parseProcStatusCtxt(partial, strlen(partial), voluntary, involuntary));
+
+    pid_t child = fork();
+    if (child == 0) {
+        while (true) {
+            usleep(1000);
+        }
+    }
+    procOptions.readStatus = true;
+    refreshProcSnapshot();
+    usleep(300000);
+    refreshProcSnapshot();
+    procOptions.readStatus = false;
+
+    float childRate = -1.0f;
+    long long selfVoluntary = -1;
+    for (const Proc &proc : getProcesses()) {
+        if (proc.pid == child) childRate = proc.ctxtVoluntaryRate;
+        if (proc.pid == getpid()) selfVoluntary = proc.ctxtVoluntary;
+    }
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+
+    CHECK(childRate > 50.0f);
+    CHECK(selfVoluntary >= 0);
+    refreshProcSnapshot();
+    bool cleared = true;
+    for (const Proc &proc : getProcesses()) {
+        cleared &= proc.ctxtVoluntary == -1 && proc.ctxtVoluntaryRate == 0.0f;
+    }
+    CHECK(cleared);  // the status file is not read while no column needs it
+    std::cout << "  sleeping child: " << childRate << " voluntary switches/s" << std::endl;
+}
+
+// Process owners, and user names that resolve in the background: a known
+// uid gets its name, an unknown one stays numeric and is only looked up
+// again once the negative TTL has passed
+static void testUserNames()
+{
+    std::cout << "User names:" << std::endl;
+
+    uid_t self = (uid_t)-1;
+    for (const Proc &proc : getProcesses()) {
+        if (proc.pid == getpid()) self = proc.uid;
+    }
+    CHECK(self == geteuid());
+
+    auto settle = [] {
+        for (int i = 0; i < 200 && getUserCacheStats().pending > 0; i++) usleep(10000);
+    };
+    struct passwd *pw = getpwuid(geteuid());
+    string name = userName(geteuid());
+    settle();
+    name = userName(geteuid());
+    CHECK(pw && name == pw->pw_name);
+
+    const uid_t unknown = 3999999;
+    CHECK(userName(unknown) == "3999999");
+    settle();
+    unsigned long lookups = getUserCacheStats().lookups;
+    CHECK(userName(unknown) == "3999999");
+    settle();
+    CHECK(getUserCacheStats().lookups == lookups);  // negative result cached
+    procOptions.userNegativeTtlS = 0;
+    userName(unknown);
+    settle();
+    procOptions.userNegativeTtlS = 60;
+    CHECK(getUserCacheStats().lookups == lookups + 1);  // retried after the TTL
+    std::cout << "  " << name << " resolved, " << getUserCacheStats().entries << " cached uids" << std::endl;
+}
+
+// Per-core /proc/stat lines, and per-core usage: a spinning thread shows
+// up as one busy core instead of being averaged away
+static void testCoreStats()
+{
+    std::cout << "Per-core CPU:" << std::endl;
+
+    int cpu = 0;
+    CPUStats stats;
+    CHECK(parseCpuStatLine("cpu  74608 2520 24433 1117073 6176 4054 1 2 3 4", cpu, stats));
+    CHECK(cpu == -1 && stats.user == 74608 && stats.idle == 1117073 && stats.guestNice == 4);
+    CHECK(parseCpuStatLine("cpu17 9361 316 3069 139593", cpu, stats));
+    CHECK(cpu == 17 && stats.idle == 139593 && stats.iowait == 0);
+    CHECK(!parseCpuStatLine("cpu3 1 2", cpu, stats));
+    CHECK(!parseCpuStatLine("intr 1 2 3 4 5", cpu, stats));
+    CHECK(!parseCpuStatLine("cpufreq 1 2 3 4", cpu, stats));
+
+    CoreStats cores;
+    CHECK(readCoreStats(cores));
+    CHECK(cores.count >= 1 && cores.count <= sysconf(_SC_NPROCESSORS_CONF));
+    long long user = 0;
+    for (int core = 0; core < cores.count; core++) user += cores.ticks[CPU_USER][core];
+    CHECK(llabs(user - cores.total.user) <= cores.count);  // the total is the sum of the cores
+
+    atomic<bool> stop(false);
+    sampleCoreUsage();
+    thread spinner([&] {
+        while (!stop) {
+        }
+    });
+    usleep(300000);
+    const CoreUsage &usage = sampleCoreUsage();
+    stop = true;
+    spinner.join();
+    float busiest = 0;
+    for (int core = 0; core < usage.count; core++) busiest = max(busiest, usage.cores[core]);
+    CHECK(busiest > 50.0f);
+    CHECK(usage.total > 0.0f && usage.total <= busiest + 0.01f);
+    std::cout << "  " << usage.count << " cores, busiest " << busiest << "%, total " << usage.total << "%"
+              << std::endl;
+}
+
+// Per-component shares of each core's interval, and the history ring
+static void testCpuBreakdown()
+{
+    std::cout << "CPU breakdown:" << std::endl;
+
+    static CoreStats prev, curr;
+    static CoreUsage usage;
+    prev = CoreStats();
+    curr = CoreStats();
+    prev.count = 2;
+    curr.count = 3;
+    curr.total = {50, 0, 20, 100, 10, 5, 5, 10, 0, 0};  // 200 ticks
+    curr.setCore(0, {25, 0, 25, 50, 0, 0, 0, 0, 0, 0});
+    curr.setCore(1, {0, 0, 0, 0, 0, 0, 0, 40, 0, 0});
+    prev.ticks[CPU_IOWAIT][1] = 5;  // iowait can go backwards; clamped to zero
+    curr.setCore(2, {10, 0, 0, 10, 0, 0, 0, 0, 0, 0});
+
+    computeCoreUsage(prev, curr, usage);
+    CHECK(usage.count == 3);
+    CHECK(fabsf(usage.totalBreakdown[CPU_USER] - 25.0f) < 0.01f);
+    CHECK(fabsf(usage.totalBreakdown[CPU_IDLE] - 50.0f) < 0.01f);
+    CHECK(fabsf(usage.totalBreakdown[CPU_STEAL] - 5.0f) < 0.01f);
+    CHECK(fabsf(usage.total - 45.0f) < 0.01f);  // neither idle nor iowait
+    float sum = 0;
+    for (int c = 0; c < CPU_COMPONENTS; c++) sum += usage.totalBreakdown[c];
+    CHECK(fabsf(sum - 100.0f) < 0.01f);
+
+    CHECK(fabsf(usage.breakdown[CPU_USER][0] - 25.0f) < 0.01f);
+    CHECK(fabsf(usage.breakdown[CPU_SYSTEM][0] - 25.0f) < 0.01f);
+    CHECK(fabsf(usage.cores[0] - 50.0f) < 0.01f);
+    CHECK(usage.breakdown[CPU_IOWAIT][1] == 0.0f);
+    CHECK(fabsf(usage.breakdown[CPU_STEAL][1] - 100.0f) < 0.01f);
+    CHECK(usage.cores[2] == 0.0f && usage.breakdown[CPU_USER][2] == 0.0f);  // just came online
+
+    CpuBreakdownHistory history;
+    float sample[CPU_COMPONENTS] = {};
+    for (int i = 0; i < CpuBreakdownHistory::capacity + 5; i++) {
+        sample[CPU_USER] = (float)i;
+        history.push(sample);
+    }
+    CHECK(history.size == CpuBreakdownHistory::capacity);
+    CHECK(history.at(CPU_USER, 0) == 5.0f);
+    CHECK(history.at(CPU_USER, history.size - 1) == (float)(CpuBreakdownHistory::capacity + 4));
+    CHECK(strcmp(cpuComponentName(CPU_STEAL), "steal") == 0);
+}
+
+// Expanding a process lists its threads with their own interval CPU%
+static void testThreadList()
+{
+    std::cout << "Thread list:" << std::endl;
+
+    atomic<bool> stop(false);
+    atomic<int> spinnerTid(0);
+    thread spinner([&] {
+        spinnerTid = gettid();
+        while (!stop) {
+        }
+    });
+    while (spinnerTid == 0) {
+        usleep(1000);
+    }
+
+    char buf[1024];
+    FILE *f = fopen("/proc/self/stat", "r");
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    Proc self = {0};
+    CHECK(parseProcStat(buf, n, self) == PROC_STAT_OK);
+
+    clockid_t spinnerClock;
+    CHECK(pthread_getcpuclockid(spinner.native_handle(), &spinnerClock) == 0);
+    ThreadList list;
+    list.key = {getpid(), self.starttime};
+    CpuMark a = cpuMark(spinnerClock);
+    CHECK(refreshThreadList(list, "/proc"));
+    CpuMark b = cpuMark(spinnerClock);
+    usleep(300000);
+    CpuMark c = cpuMark(spinnerClock);
+    CHECK(refreshThreadList(list, "/proc"));
+    CpuMark d = cpuMark(spinnerClock);
+    stop = true;
+    spinner.join();
+
+    float spinnerCpu = -1.0f, mainCpu = -1.0f;
+    for (const Proc &t : list.threads) {
+        if (t.pid == spinnerTid) spinnerCpu = t.cpu_percent;
+        if (t.pid == getpid()) mainCpu = t.cpu_percent;
+    }
+    CHECK(list.threads.size() >= 2);
+    CHECK(spinnerCpu > 0.0f && plausibleCpu(spinnerCpu, a, b, c, d));
+    CHECK(mainCpu >= 0.0f && mainCpu < 50.0f);
+
+    // A recycled pid (different starttime) and a missing one both read as exited
+    ThreadList recycled;
+    recycled.key = {getpid(), self.starttime + 1};
+    CHECK(!refreshThreadList(recycled, "/proc") && recycled.threads.empty());
+    ThreadList missing;
+    missing.key = {INT_MAX, 0};
+    CHECK(!refreshThreadList(missing, "/proc"));
+    std::cout << "  " << list.threads.size() << " threads, spinning: " << spinnerCpu << "%, main: " << mainCpu << "%"
+              << std::endl;
+}
+
+// Netlink tracking must either see a forked child through the connector
+// or fall back to the /proc scan with a reason.
+static void testProcEvents()
+{
+    std::cout << "Proc connector:" << std::endl;
+
+    procOptions.useProcEvents = true;
+    refreshProcSnapshot();
+    if (getProcTrackMode() == PROC_TRACK_SCAN) {
+        CHECK(!getProcTrackError().empty());
+        std::cout << "  unavailable, using /proc scan (" << getProcTrackError() << ")" << std::endl;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        pause();
+        _exit(0);
+    }
+    usleep(10000);
+    refreshProcSnapshot();
+    const ProcSnapshot &snap = getProcSnapshot();
+    bool added = false;
+    for (const ProcChange &change : snap.changes.added) {
+        added |= change.key.pid == child;
+    }
+    CHECK(added);
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    refreshProcSnapshot();
+    bool removed = false;
+    for (const ProcChange &change : snap.changes.removed) {
+        removed |= change.key.pid == child;
+    }
+    CHECK(removed);
+    if (getProcTrackMode() == PROC_TRACK_NETLINK) {
+        std::cout << "  tracking via proc connector" << std::endl;
+    }
+
+    procOptions.useProcEvents = false;
+    refreshProcSnapshot();
+    CHECK(getProcTrackMode() == PROC_TRACK_SCAN);
+}
+
+// A short-lived child must show up in the exited-task table with its CPU time
+static void testTaskExits()
+{
+    std::cout << "Taskstats exits:" << std::endl;
+
+    string error;
+    if (!openTaskExits(error)) {
+        CHECK(!error.empty());
+        std::cout << "  unavailable (" << error << ")" << std::endl;
+        return;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        prctl(PR_SET_NAME, "exit-probe");
+        clock_t start = clock();
+        while (clock() - start < CLOCKS_PER_SEC / 20) {
+        }
+        _exit(0);
+    }
+    waitpid(child, nullptr, 0);
+    usleep(20000);
+    pollTaskExits();
+    closeTaskExits();
+
+    const ExitedCommand *probe = nullptr;
+    for (const ExitedCommand &cmd : getExitedCommands()) {
+        if (cmd.name == "exit-probe") probe = &cmd;
+    }
+    CHECK(probe != nullptr);
+    if (probe) {
+        CHECK(probe->tasks == 1);
+        CHECK(probe->cpuUsec > 10000);
+        CHECK(probe->maxRssKB > 0);
+        std::cout << "  exit-probe: " << probe->cpuUsec << " us CPU, " << probe->maxRssKB << " KB max RSS" << std::endl;
+    }
+    clearExitedCommands();
+}
+
+// Apply one round of synthetic churn to a hand-built snapshot: update,
+// remove and add a few rows, recording the change set like a refresh does.
+static void churnSnapshot(ProcSnapshot &snap, int &nextPid)
+{
+    ProcTable &table = snap.table;
+    snap.generation++;
+    snap.passes++;
+    snap.changes = ProcChanges();
+    for (uint32_t row = 0; row < table.size(); row++) {
+        if (!table.alive[row] || rand() % 20 != 0) continue;
+        if (rand() % 4 == 0) {
+            snap.changes.removed.push_back({table.key(row), row});
+            snap.index.erase(table.key(row));
+            snap.names.release(table.nameId[row]);
+            table.erase(row);
+        } else {
+            table.cpuPercent[row] = rand() % 400 / 4.0f;
+            table.rss[row] = rand() % 1000;
+            if (rand() % 10 == 0) table.ppid[row] = rand() % table.pid[row];
+            snap.changes.updated.push_back({table.key(row), row});
+        }
+    }
+    for (int i = rand() % 50; i > 0; i--) {
+        Proc proc = {0};
+        proc.pid = nextPid++;
+        proc.ppid = rand() % proc.pid;  // parents are older, so no cycles
+        proc.state = "RSZ"[rand() % 3];
+        proc.cpu_percent = rand() % 400 / 4.0f;
+        proc.rss = rand() % 1000;
+        proc.name = "Proc" + to_string(rand() % 300);
+        uint32_t row = table.insert(proc, snap.names.intern(proc.name));
+        snap.index[table.key(row)] = row;
+        snap.changes.added.push_back({table.key(row), row});
+    }
+}
+
+// The incrementally repaired order must always equal a full sort
+static void testProcOrder()
+{
+    std::cout << "Incremental sort:" << std::endl;
+
+    srand(99);
+    ProcSnapshot snap = ProcSnapshot();
+    int nextPid = 1;
+    for (int i = 0; i < 20; i++) {
+        churnSnapshot(snap, nextPid);
+    }
+
+    const vector<ProcSortKey> keySets[] = {
+        {{PROC_SORT_CPU, true}},
+        {{PROC_SORT_MEMORY, true}, {PROC_SORT_NAME, false}},
+        {{PROC_SORT_STATE, false}, {PROC_SORT_CPU, true}},
+    };
+    for (const vector<ProcSortKey> &keys : keySets) {
+        ProcOrder incremental;
+        CHECK(updateProcOrder(incremental, snap, keys));
+        int mismatches = 0;
+        for (int round = 0; round < 30; round++) {
+            churnSnapshot(snap, nextPid);
+            CHECK(!updateProcOrder(incremental, snap, keys));
+            ProcOrder full;
+            updateProcOrder(full, snap, keys);
+            mismatches += incremental.rows != full.rows;
+        }
+        CHECK(mismatches == 0);
+    }
+    std::cout << "  " << snap.table.count() << " rows, order matches a full sort after each round" << std::endl;
+}
+
+// The filter (trigram index + cached per-name results) must agree with a
+// plain case-insensitive substring search, before and after churn.
+static void testProcFilter()
+{
+    std::cout << "Name filter:" << std::endl;
+
+    srand(7);
+    ProcSnapshot snap = ProcSnapshot();
+    int nextPid = 1;
+    for (int i = 0; i < 20; i++) {
+        churnSnapshot(snap, nextPid);
+    }
+    snap.names.intern("Web Content");
+    snap.names.intern("tmux: server");
+
+    const char *queries[] = {"PROC1", "oc", "c2", "proc", "web c", "X: SER", "zzz", "proc29"};
+    ProcOrder order;
+    const vector<ProcSortKey> keys = {{PROC_SORT_PID, false}};
+    for (const char *query : queries) {
+        string lowerQuery = query;
+        for (char &c : lowerQuery) c = tolower((unsigned char)c);
+
+        vector<uint8_t> indexed;
+        snap.names.matchAll(lowerQuery, indexed);
+        for (uint32_t id = 0; id < snap.names.names.size(); id++) {
+            string name = snap.names.names[id];
+            for (char &c : name) c = tolower((unsigned char)c);
+            bool expected = snap.names.refs[id] > 0 && name.find(lowerQuery) != string::npos;
+            CHECK((bool)indexed[id] == expected);
+        }
+
+        ProcFilter filter;
+        for (int round = 0; round < 5; round++) {
+            churnSnapshot(snap, nextPid);
+            updateProcOrder(order, snap, keys);
+            const vector<uint32_t> &rows = updateProcFilter(filter, snap, order, query);
+            vector<uint32_t> expected;
+            for (uint32_t row : order.rows) {
+                if (snap.names.lower[snap.table.nameId[row]].find(lowerQuery) != string::npos) expected.push_back(row);
+            }
+            CHECK(rows == expected);
+        }
+    }
+
+    // Repeated trigrams are indexed once per name, and released names give
+    // back exactly what they indexed
+    NameTable names;
+    uint32_t repeats = names.intern("aaaa"), cycle = names.intern("abcabc");
+    CHECK(names.liveTrigrams == 1 + 3 && names.staleTrigrams == 0);
+    names.release(repeats);
+    CHECK(names.liveTrigrams == 3 && names.staleTrigrams == 1);
+    names.release(cycle);
+    CHECK(names.liveTrigrams == 0 && names.staleTrigrams == 4);
+    size_t postings = 0;
+    for (const auto &entry : names.trigrams) postings += entry.second.size();
+    CHECK(postings == 4);
+
+    std::cout << "  " << snap.names.ids.size() << " names, " << sizeof(queries) / sizeof(queries[0])
+              << " queries match a linear search" << std::endl;
+}
+
+// Selection follows processes by key, forgets exited ones and keeps totals
+static void testProcSelection()
+{
+    std::cout << "Selection:" << std::endl;
+
+    srand(21);
+    ProcSnapshot snap = ProcSnapshot();
+    int nextPid = 1;
+    for (int i = 0; i < 10; i++) {
+        churnSnapshot(snap, nextPid);
+    }
+
+    ProcSelection sel;
+    updateProcSelection(sel, snap);
+    for (uint32_t row = 0; row < snap.table.size(); row++) {
+        if (snap.table.alive[row] && row % 3 == 0) selectProc(sel, snap, row, true);
+    }
+    size_t selected = sel.rows.size();
+    CHECK(selected > 0);
+    uint32_t first = sel.rows.begin()->second;
+    selectProc(sel, snap, first, true);
+    CHECK(sel.rows.size() == selected - 1 && !sel.contains(snap.table.key(first)));
+    selectProc(sel, snap, first, true);
+
+    size_t dropped = 0;
+    for (int round = 0; round < 40; round++) {
+        size_t before = sel.rows.size();
+        if (round == 20) {
+            churnSnapshot(snap, nextPid);  // skipped by the selection
+        }
+        churnSnapshot(snap, nextPid);
+        updateProcSelection(sel, snap);
+        dropped += before - sel.rows.size();
+
+        float cpu = 0;
+        long long rss = 0;
+        for (const auto &entry : sel.rows) {
+            CHECK(snap.table.alive[entry.second] && snap.table.key(entry.second) == entry.first);
+            cpu += snap.table.cpuPercent[entry.second];
+            rss += snap.table.rss[entry.second];
+        }
+        CHECK(fabs(cpu - sel.cpuPercent) < 0.01f && rss == sel.rss);
+        CHECK(sel.history.size() <= sel.rows.size());
+    }
+    CHECK(dropped > 0);
+    CHECK(sel.rows.empty() || sel.history[sel.rows.begin()->first].size() > 1);
+
+    selectProc(sel, snap, sel.rows.empty() ? 0 : sel.rows.begin()->second, false);
+    updateProcSelection(sel, snap);
+    CHECK(sel.rows.size() == 1 && sel.history.size() <= 1);
+    std::cout << "  " << selected << " selected, " << dropped << " dropped on exit" << std::endl;
+}
+
+// The incrementally maintained tree must equal one built from scratch
+static void testProcTree()
+{
+    std::cout << "Process tree:" << std::endl;
+
+    srand(5);
+    ProcSnapshot snap = ProcSnapshot();
+    int nextPid = 1;
+    for (int i = 0; i < 10; i++) {
+        churnSnapshot(snap, nextPid);
+    }
+
+    ProcTree tree;
+    CHECK(updateProcTree(tree, snap));
+    int mismatches = 0, rebuilds = 0;
+    size_t deepest = 0;
+    for (int round = 0; round < 60; round++) {
+        if (round == 30) {
+            churnSnapshot(snap, nextPid);  // skipped by the tree
+        }
+        churnSnapshot(snap, nextPid);
+        rebuilds += updateProcTree(tree, snap);
+
+        const ProcTable &table = snap.table;
+        unordered_set<uint32_t> changed;
+        for (const vector<ProcChange> *changes : {&snap.changes.added, &snap.changes.updated}) {
+            for (const ProcChange &change : *changes) changed.insert(change.row);
+        }
+        unordered_map<int, uint32_t> rowOfPid;
+        for (uint32_t row = 0; row < table.size(); row++) {
+            if (table.alive[row]) rowOfPid[table.pid[row]] = row;
+        }
+        size_t roots = 0;
+        vector<double> cpu(table.size(), 0);
+        vector<long long> rss(table.size(), 0);
+        for (uint32_t row = 0; row < table.size(); row++) {
+            if (!table.alive[row]) continue;
+            // Expected parent: the row of ppid, unless this row was orphaned
+            // and has not been updated since (then the tree keeps it a root)
+            uint32_t parent = tree.parent[row];
+            auto it = rowOfPid.find(table.ppid[row]);
+            if (parent != ProcTree::none) {
+                if (it == rowOfPid.end() || it->second != parent) mismatches++;
+            } else if (it != rowOfPid.end() && changed.count(row)) {
+                mismatches++;
+            }
+            size_t depth = 0;
+            for (uint32_t a = row; a != ProcTree::none; a = tree.parent[a], depth++) {
+                cpu[a] += table.cpuPercent[row];
+                rss[a] += table.rss[row];
+            }
+            deepest = max(deepest, depth);
+        }
+        for (uint32_t row = 0; row < table.size(); row++) {
+            if (!table.alive[row]) continue;
+            if (fabs(cpu[row] - tree.subtreeCpu[row]) > 0.01 || rss[row] != tree.subtreeRss[row]) mismatches++;
+            for (uint32_t child : tree.children[row]) {
+                if (tree.parent[child] != row || !table.alive[child]) mismatches++;
+            }
+            uint32_t parent = tree.parent[row];
+            const vector<uint32_t> &list = parent == ProcTree::none ? tree.roots : tree.children[parent];
+            if (list[tree.slot[row]] != row) mismatches++;
+            roots += parent == ProcTree::none;
+        }
+        if (roots != tree.roots.size()) mismatches++;
+    }
+    CHECK(mismatches == 0);
+    CHECK(rebuilds == 1);
+
+    // With every node open, the layout reaches each live row exactly once,
+    // and each level is ordered by subtree CPU
+    ProcTreeView view;
+    for (uint32_t row = 0; row < snap.table.size(); row++) {
+        if (snap.table.alive[row]) view.open.insert(snap.table.key(row));
+    }
+    layoutProcTree(view, snap, tree);
+    unordered_set<uint32_t> laidOut;
+    bool ordered = true;
+    for (size_t i = 0; i < view.lines.size(); i++) {
+        laidOut.insert(view.lines[i].first);
+        for (size_t j = i + 1; j < view.lines.size() && view.lines[j].second >= view.lines[i].second; j++) {
+            if (view.lines[j].second != view.lines[i].second) continue;
+            ordered &= tree.subtreeCpu[view.lines[i].first] >= tree.subtreeCpu[view.lines[j].first];
+            break;
+        }
+    }
+    CHECK(laidOut.size() == view.lines.size() && laidOut.size() == snap.table.count());
+    CHECK(ordered);
+
+    // Refreshes within a pass keep the sorted lists and only patch their
+    // membership; every live row is still laid out once
+    bool covered = true;
+    for (int round = 0; round < 10; round++) {
+        churnSnapshot(snap, nextPid);
+        snap.passes--;
+        updateProcTree(tree, snap);
+        for (const ProcChange &change : snap.changes.added) view.open.insert(change.key);
+        layoutProcTree(view, snap, tree);
+        laidOut.clear();
+        for (const pair<uint32_t, int> &line : view.lines) laidOut.insert(line.first);
+        covered &= laidOut.size() == view.lines.size() && laidOut.size() == snap.table.count();
+    }
+    CHECK(covered);
+    std::cout << "  " << snap.table.count() << " rows, depth " << deepest << ", totals match a full walk" << std::endl;
+}
+
+// The bounded heaps must pick the same rows as a full sort of each metric
+static void testProcTopN()
+{
+    std::cout << "Top consumers:" << std::endl;
+
+    srand(6);
+    ProcSnapshot snap = ProcSnapshot();
+    int nextPid = 1;
+    ProcTopN top;
+    int mismatches = 0;
+    for (int round = 0; round < 60; round++) {
+        churnSnapshot(snap, nextPid);
+        ProcTable &table = snap.table;
+        for (uint32_t row = 0; row < table.size(); row++) {
+            if (rand() % 10 == 0) table.ioWait[row] = rand() % 40 / 4.0f;
+        }
+        top.n = round % 3 == 0 ? 3 : 10;
+        updateProcTopN(top, snap);
+
+        for (int metric = 0; metric < PROC_TOP_METRICS; metric++) {
+            auto value = [&](uint32_t row) {
+                if (metric == PROC_TOP_CPU) return (double)table.cpuPercent[row];
+                if (metric == PROC_TOP_RSS) return (double)table.rss[row];
+                return (double)table.ioWait[row];
+            };
+            vector<uint32_t> expected;
+            for (uint32_t row = 0; row < table.size(); row++) {
+                if (table.alive[row] && value(row) > 0) expected.push_back(row);
+            }
+            sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) {
+                return value(a) != value(b) ? value(a) > value(b) : a > b;
+            });
+            expected.resize(min(expected.size(), top.n));
+            if (top.rows[metric] != expected) mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(top.rows[PROC_TOP_CPU].size() == top.n && top.rows[PROC_TOP_IO_WAIT].size() == top.n);
+    std::cout << "  " << snap.table.count() << " rows, top " << top.n << " per metric matches a full sort"
+              << std::endl;
+}
+
+// /proc/[pid]/io parsing, and rates read within the per-refresh budget
+static void testProcIo()
+{
+    std::cout << "Process I/O:" << std::endl;
+
+    const char golden[] = "rchar: 323934931\nwchar: 323929600\nsyscr: 632687\nsyscw: 632675\n"
+                          "read_bytes: 4096\nwrite_bytes: 323932160\ncancelled_write_bytes: 0\n";
+    ProcIoCounters counters = {};
+    CHECK(parseProcIo(golden, sizeof(golden) - 1, counters));
+    CHECK(counters.rchar == 323934931 && counters.syscr == 632687 && counters.syscw == 632675);
+    CHECK(counters.readBytes == 4096 && counters.writeBytes == 323932160 && counters.cancelledWriteBytes == 0);
+    CHECK(!parseProcIo(golden, 40, counters));
+    CHECK(!parseProcIo("", 0, counters));
+    CHECK(readProcIo("/proc", getpid(), counters) == PROC_IO_OK);
+    CHECK(readProcIo("/proc", INT_MAX, counters) == PROC_IO_GONE);
+
+    // Every row is wanted on every refresh, but only `budget` are read per
+    // refresh; stalest-first means all of them get a turn.
+    ProcIoRates io;
+    io.budget = 5;
+    ProcSelection none;
+    int rounds = 0, overBudget = 0;
+    bool repeated = false;
+    size_t unread = 1;
+    while (unread > 0 && rounds < 100) {
+        refreshProcSnapshot();
+        const ProcSnapshot &snap = getProcSnapshot();
+        for (uint32_t row = 0; row < snap.table.size(); row++) {
+            if (snap.table.alive[row]) {
+                io.want(row);
+                io.want(row);  // drawn again on a later frame
+            }
+        }
+        repeated |= io.wanted.size() > snap.table.count();
+        updateProcIoRates(io, snap, none);
+        overBudget += io.readsLastRefresh > io.budget;
+        rounds++;
+        unread = 0;
+        for (uint32_t row = 0; row < snap.table.size(); row++) {
+            if (!snap.table.alive[row]) continue;
+            const ProcIoRates::Entry *entry = io.find(snap.table.key(row));
+            unread += !entry || (entry->generation == 0 && !entry->denied);
+        }
+    }
+    CHECK(unread == 0 && overBudget == 0 && !repeated);
+
+    // Selected rows are sampled without being drawn; our own write()s show up
+    const ProcSnapshot &snap = getProcSnapshot();
+    ProcSelection self;
+    for (uint32_t row = 0; row < snap.table.size(); row++) {
+        if (snap.table.alive[row] && snap.table.pid[row] == getpid()) selectProc(self, snap, row, false);
+    }
+    CHECK(self.rows.size() == 1);
+    ProcIoRates selected;
+    for (int round = 0; round < 2; round++) {
+        FILE *f = fopen("/dev/null", "w");
+        for (int i = 0; i < 100; i++) {
+            fputc('x', f);
+            fflush(f);
+        }
+        fclose(f);
+        usleep(50000);
+        refreshProcSnapshot();
+        updateProcSelection(self, getProcSnapshot());
+        updateProcIoRates(selected, getProcSnapshot(), self);
+    }
+    const ProcIoRates::Entry *entry = self.rows.empty() ? nullptr : selected.find(self.rows.begin()->first);
+    CHECK(entry && entry->hasRates && entry->syscw >= 100);
+    std::cout << "  all rows read within " << rounds << " refreshes at " << io.budget << " per refresh, "
+              << "own write rate " << (entry ? entry->syscw : 0) << " syscalls/s" << std::endl;
+}
+
+// smaps_rollup parsing, and the background reader's budget and pruning
+static void testSmaps()
+{
+    std::cout << "smaps_rollup:" << std::endl;
+
+    const char golden[] = "564a4c289000-7ffde2fd2000 ---p 00000000 00:00 0                          [rollup]\n"
+                          "Rss:                1252 kB\nPss:                 335 kB\nPss_Dirty:           100 kB\n"
+                          "Shared_Clean:       1112 kB\nShared_Dirty:          0 kB\nPrivate_Clean:        40 kB\n"
+                          "Private_Dirty:       100 kB\nSwap:                 12 kB\nSwapPss:               6 kB\n";
+    SmapsRollup rollup = {};
+    CHECK(parseSmapsRollup(golden, sizeof(golden) - 1, rollup));
+    CHECK(rollup.rss == 1252 * 1024 && rollup.pss == 335 * 1024);
+    CHECK(rollup.shared == 1112 * 1024 && rollup.uss == 140 * 1024);
+    CHECK(rollup.swap == 12 * 1024 && rollup.swapPss == 6 * 1024);
+    CHECK(!parseSmapsRollup(golden, 120, rollup));
+
+    const ProcSnapshot &snap = getProcSnapshot();
+    ProcKey self = {0, 0};
+    for (const auto &entry : snap.index) {
+        if (entry.first.pid == getpid()) self = entry.first;
+    }
+    CHECK(self.pid == getpid());
+
+    // Reads are checked against the process's start time, so a reused pid
+    // never reports another process's memory
+    CHECK(readSmapsRollup(self, rollup) && rollup.pss > 0);
+    CHECK(!readSmapsRollup({self.pid, self.starttime + 1}, rollup));
+
+    // A zero budget reads nothing
+    int budget = procOptions.smapsBudgetMs;
+    procOptions.smapsBudgetMs = 0;
+    requestSmaps({self});
+    usleep(50000);
+    pollSmaps();
+    CHECK(getSmaps().empty());
+
+    procOptions.smapsBudgetMs = budget;
+    requestSmaps({self});
+    for (int wait = 0; wait < 200 && getSmaps().empty(); wait++) {
+        usleep(10000);
+        pollSmaps();
+    }
+    auto it = getSmaps().find(self);
+    CHECK(it != getSmaps().end());
+    if (it != getSmaps().end()) {
+        const SmapsRollup &mem = it->second;
+        CHECK(mem.rss > 0 && mem.pss > 0 && mem.pss <= mem.rss && mem.uss <= mem.pss);
+        std::cout << "  self: RSS " << formatBytes(mem.rss) << ", PSS " << formatBytes(mem.pss) << ", USS "
+                  << formatBytes(mem.uss) << std::endl;
+    }
+
+    // Results of processes that are no longer requested are dropped
+    requestSmaps({});
+    pollSmaps();
+    CHECK(getSmaps().empty());
+}
+
+// Write one file of a synthetic cgroup tree
+static void writeCgroupFile(const string &dir, const char *file, const string &contents)
+{
+    FILE *f = fopen((dir + "/" + file).c_str(), "w");
+    if (!f) return;
+    fputs(contents.c_str(), f);
+    fclose(f);
+}
+
+static void makeCgroup(const string &dir, long long usageUsec, const string &procs)
+{
+    mkdir(dir.c_str(), 0755);
+    writeCgroupFile(dir, "cpu.stat", "usage_usec " + to_string(usageUsec) + "\nuser_usec 0\nsystem_usec 0\n"
+                                     "nr_periods 0\nnr_throttled 0\nthrottled_usec 7\n");
+    writeCgroupFile(dir, "memory.current", "1048576\n");
+    writeCgroupFile(dir, "memory.stat", "anon_thp 0\nanon 4096\nfile 8192\n");
+    writeCgroupFile(dir, "io.stat", "8:0 rbytes=100 wbytes=200 rios=1 wios=2 dbytes=0 dios=0\n"
+                                    "8:16 rbytes=1000 wbytes=2000 rios=10 wios=20 dbytes=0 dios=0\n");
+    writeCgroupFile(dir, "cpu.pressure", "some avg10=1.50 avg60=0.00 avg300=0.00 total=10\n");
+    writeCgroupFile(dir, "cgroup.procs", procs);
+}
+
+static void removeCgroup(const string &dir)
+{
+    for (const char *file : {"cpu.stat", "memory.current", "memory.stat", "io.stat", "cpu.pressure", "cgroup.procs"}) {
+        unlink((dir + "/" + file).c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+// cgroup walk, stats, rates and process attachment on a synthetic hierarchy
+static void testCgroups()
+{
+    std::cout << "Cgroups:" << std::endl;
+
+    string path;
+    const char selfCgroup[] = "12:memory:/docker/abc\n0::/system.slice/ssh.service\n";
+    CHECK(parseCgroupPath(selfCgroup, sizeof(selfCgroup) - 1, path) && path == "/system.slice/ssh.service");
+    CHECK(!parseCgroupPath("4:cpu:/x\n", 9, path));
+
+    char dir[] = "/tmp/monitor-test-cgroup-XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    string root = dir;
+    makeCgroup(root, 1000000, "1\n");
+    makeCgroup(root + "/a", 500000, "");
+    makeCgroup(root + "/a/b", 200000, to_string(getpid()) + "\n");
+    makeCgroup(root + "/c", 0, "");
+
+    const ProcSnapshot &snap = getProcSnapshot();
+    refreshCgroups(snap, root.c_str());
+    const CgroupSnapshot &cg = getCgroups();
+    vector<string> paths;
+    for (uint32_t id : cg.order) paths.push_back(cg.groups[id].path);
+    CHECK((paths == vector<string>{"/", "/a", "/a/b", "/c"}));
+
+    uint32_t b = cg.index.at("/a/b");
+    const CgroupStats &group = cg.groups[b];
+    CHECK(group.depth == 2 && group.processes == 1);
+    CHECK(group.memoryCurrent == 1048576 && group.anon == 4096 && group.file == 8192);
+    CHECK(group.readBytes == 1100 && group.writeBytes == 2200 && group.rios == 11 && group.wios == 22);
+    CHECK(group.throttledUsec == 7 && fabs(group.pressureSome10 - 1.5f) < 0.001f);
+    bool attached = false;
+    for (const auto &entry : cg.procGroup) {
+        if (entry.first.pid == getpid()) attached = entry.second == b;
+    }
+    CHECK(attached);
+
+    // Stat files are read once per pass, not again for the same one
+    usleep(100000);
+    makeCgroup(root + "/a/b", 300000, to_string(getpid()) + "\n");
+    refreshCgroups(snap, root.c_str());
+    CHECK(cg.groups[b].usageUsec == 200000);
+    // Only the stat files change between refreshes; rates follow them
+    refreshProcSnapshot();
+    refreshCgroups(snap, root.c_str());
+    CHECK(cg.index.at("/a/b") == b);
+    float cpu = cg.groups[b].cpuPercent;
+    CHECK(cpu > 10.0f && cpu <= 100.0f);
+
+    // A removed group is noticed on the next read and dropped by a re-walk
+    removeCgroup(root + "/c");
+    refreshProcSnapshot();
+    refreshCgroups(snap, root.c_str());
+    refreshProcSnapshot();
+    refreshCgroups(snap, root.c_str());
+    CHECK(!cg.index.count("/c") && cg.order.size() == 3);
+    std::cout << "  " << cg.order.size() << " groups after removal, /a/b at " << cpu << "% CPU" << std::endl;
+
+    removeCgroup(root + "/a/b");
+    removeCgroup(root + "/a");
+    removeCgroup(root);
+}
 
 int main() {
     std::cout << "=== System Monitor Function Tests ===" << std::endl;
+    // Every refresh in these tests is a full pass unless a test sets a budget
+    procOptions.scanBudgetUs = 0;
     
     // Test OS name
     std::cout << "OS Name: " << getOsName() << std::endl;
@@ -149,6 +1284,28 @@ int main() {
     FanInfo fan = getFanInfo();
     std::cout << "Fan - Enabled: " << (fan.enabled ? "Yes" : "No") 
               << ", Speed: " << fan.speed << " RPM, Level: " << fan.level << std::endl;
-    
-    return 0;
+
+    testProcStatParser();
+    testProcTable();
+    testScanBudget();
+    testListPids();
+    testIntervalCpu();
+    testCtxtSwitchRates();
+    testUserNames();
+    testCoreStats();
+    testCpuBreakdown();
+    testThreadList();
+    testProcIo();
+    testSmaps();
+    testCgroups();
+    testProcEvents();
+    testTaskExits();
+    testProcOrder();
+    testProcFilter();
+    testProcSelection();
+    testProcTree();
+    testProcTopN();
+
+    std::cout << (failures ? "FAILED" : "PASSED") << " (" << failures << " failures)" << std::endl;
+    return failures ? 1 : 0;
 }
\ No newline at end of file
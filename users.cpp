@@ -0,0 +1,122 @@
+#include "header.h"
+#include <pwd.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// uid -> name cache. Lookups never call into NSS themselves: a uid seen
+// for the first time is queued for the resolver thread and shown as a
+// number until its name arrives. Names that were found are kept; uids
+// without a passwd entry are retried after procOptions.userNegativeTtlS.
+class UserCache
+{
+public:
+    ~UserCache()
+    {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    string lookup(uid_t uid)
+    {
+        double now = monotonicSeconds();
+        lock_guard<mutex> lock(m);
+        auto it = entries.find(uid);
+        if (it == entries.end()) {
+            it = entries.emplace(uid, Entry{to_string(uid), ENTRY_PENDING, 0}).first;
+            enqueue(uid);
+        } else if (it->second.state == ENTRY_MISSING && now >= it->second.missedAt + procOptions.userNegativeTtlS) {
+            it->second.state = ENTRY_PENDING;
+            enqueue(uid);
+        }
+        return it->second.name;
+    }
+
+    UserCacheStats stats()
+    {
+        lock_guard<mutex> lock(m);
+        return {entries.size(), queue.size() + (resolving ? 1 : 0), lookups};
+    }
+
+private:
+    enum EntryState { ENTRY_PENDING, ENTRY_FOUND, ENTRY_MISSING };
+    struct Entry {
+        string name;
+        EntryState state;
+        double missedAt;  // when the lookup found no passwd entry
+    };
+
+    // Called with `m` held
+    void enqueue(uid_t uid)
+    {
+        queue.push_back(uid);
+        if (!worker.joinable()) {
+            worker = thread([this] { loop(); });
+        }
+        wake.notify_one();
+    }
+
+    void loop()
+    {
+        vector<char> buf(16384);
+        while (true) {
+            uid_t uid;
+            {
+                unique_lock<mutex> lock(m);
+                resolving = false;
+                wake.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (stopping) return;
+                uid = queue.front();
+                queue.pop_front();
+                resolving = true;
+                lookups++;
+            }
+
+            // May block for as long as the directory service takes
+            struct passwd pw, *result = nullptr;
+            int err;
+            while ((err = getpwuid_r(uid, &pw, buf.data(), buf.size(), &result)) == ERANGE && buf.size() < (1 << 20)) {
+                buf.resize(buf.size() * 2);
+            }
+            bool found = err == 0 && result != nullptr;
+            string name = found ? pw.pw_name : "";
+
+            lock_guard<mutex> lock(m);
+            Entry &entry = entries[uid];
+            if (found) {
+                entry.name = name;
+                entry.state = ENTRY_FOUND;
+            } else {
+                entry.name = to_string(uid);
+                entry.state = ENTRY_MISSING;
+                entry.missedAt = monotonicSeconds();
+            }
+        }
+    }
+
+    thread worker;
+    mutex m;
+    condition_variable wake;
+    bool stopping = false;
+    bool resolving = false;
+    unordered_map<uid_t, Entry> entries;
+    deque<uid_t> queue;
+    unsigned long lookups = 0;
+};
+
+static UserCache userCache;
+
+string userName(uid_t uid)
+{
+    return userCache.lookup(uid);
+}
+
+UserCacheStats getUserCacheStats()
+{
+    return userCache.stats();
+}